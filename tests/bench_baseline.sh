@@ -0,0 +1,32 @@
+#!/bin/sh
+# Linha de base do benchmark (ver "Benchmark do simulador" no README). Compila tomasulo_bench.cpp
+# e, se ARQUIVO não existe, grava nele a linha de base da máquina atual; se existe, compara a
+# execução atual com ele e termina com código 1 se alguma carga ficou mais lenta que a
+# tolerância (ou se o arquivo foi gravado com outro número de instruções ou outro modo).
+#
+# Uso: tests/bench_baseline.sh ARQUIVO [OPCOES DO BENCHMARK]...
+#   ex.: tests/bench_baseline.sh base.txt --instructions 200000 --tolerance 5
+# A linha de base depende da máquina: grave-a antes da mudança e compare depois, na mesma
+# máquina e com as mesmas opções. CXX e CXXFLAGS escolhem o compilador e as opções (padrão:
+# g++ e -O2).
+
+set -u
+if [ $# -lt 1 ]; then
+    echo "Uso: $0 ARQUIVO [OPCOES DO BENCHMARK]..." >&2
+    exit 2
+fi
+baseline=$1
+shift
+
+TESTS=$(cd "$(dirname "$0")" && pwd)
+BUILD=$(mktemp -d)
+trap 'rm -rf "$BUILD"' EXIT
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2}
+$CXX -std=c++11 $CXXFLAGS -pthread -o "$BUILD/tomasulo_bench" "$TESTS/../tomasulo_bench.cpp" || exit 1
+
+if [ -f "$baseline" ]; then
+    "$BUILD/tomasulo_bench" --baseline "$baseline" "$@"
+else
+    "$BUILD/tomasulo_bench" --save-baseline "$baseline" "$@"
+fi
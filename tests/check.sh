@@ -0,0 +1,99 @@
+#!/bin/sh
+# Testes de regressão do simulador (ver "Testes" no README). Compila o simulador e
+# tests/cosim_random.cpp, executa cada programa de tests/programs nos quatro modos (ciclo a
+# ciclo e --event-driven, com rename = rob e rename = prf), com --cosim, e compara os
+# registradores finais com os de NOME.expected. Depois roda a co-simulação aleatória e confere
+# que a varredura em lote (LockstepSweep) dá o mesmo CSV que uma instância por configuração
+# (--no-lockstep), em programas aleatórios sem desvios.
+# Termina com código 1 se algum teste falhar.
+#
+# Uso: tests/check.sh [--update]
+#   --update  regrava os .expected com a execução ciclo a ciclo com rename = rob (as demais
+#             continuam sendo comparadas com ela)
+# CXX e CXXFLAGS escolhem o compilador e as opções (padrão: g++ e -O2).
+
+set -u
+update=0
+[ "${1:-}" = "--update" ] && update=1
+
+TESTS=$(cd "$(dirname "$0")" && pwd)
+BUILD=$(mktemp -d)
+trap 'rm -rf "$BUILD"' EXIT
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--O2}
+$CXX -std=c++11 $CXXFLAGS -pthread -o "$BUILD/tomasulo" "$TESTS/../tomasulo.cpp" || exit 1
+$CXX -std=c++11 $CXXFLAGS -pthread -I"$TESTS/.." -o "$BUILD/cosim_random" "$TESTS/cosim_random.cpp" || exit 1
+
+runs=0
+failures=0
+cd "$TESTS/programs" || exit 1
+for program in *.txt; do
+    name=${program%.txt}
+    # Cada teste tem a linha "# opcoes: ..." (as opções do simulador, talvez nenhuma); os demais
+    # arquivos são programas de outras threads (--thread-program).
+    grep -q '^# opcoes:' "$program" || continue
+    options=$(sed -n 's/^# opcoes: //p' "$program")
+    # Com SMT, só rename = rob e sem --cosim: os registradores de cada thread são os conferidos.
+    case " $options " in
+        *smt.threads=*) renames="rob"; cosim="" ;;
+        *) renames="rob prf"; cosim="--cosim" ;;
+    esac
+    for rename in $renames; do
+        for event in "" --event-driven; do
+            mode=${event:-ciclo a ciclo}
+            runs=$((runs + 1))
+            output=$("$BUILD/tomasulo" "$program" --batch $event --set rename=$rename $cosim $options 2>"$BUILD/errors")
+            status=$?
+            registers=$(printf '%s\n' "$output" | sed -n '/^Valores Finais/,$p')
+            if [ $update -eq 1 ] && [ $rename = rob ] && [ -z "$event" ] && [ $status -eq 0 ]; then
+                printf '%s\n' "$registers" > "$name.expected"
+            fi
+            if [ $status -ne 0 ]; then
+                echo "FALHA $name ($mode, rename=$rename): codigo de saida $status"
+                sed 's/^/    /' "$BUILD/errors"
+                failures=$((failures + 1))
+            elif [ "$registers" != "$(cat "$name.expected")" ]; then
+                echo "FALHA $name ($mode, rename=$rename): registradores finais diferentes de $name.expected"
+                printf '%s\n' "$registers" | diff "$name.expected" - | sed 's/^/    /'
+                failures=$((failures + 1))
+            fi
+        done
+    done
+done
+echo "Programas de tests/programs: $runs execucoes, $failures com falha"
+
+"$BUILD/cosim_random" || failures=$((failures + 1))
+
+# Varredura em lote: programas de cosim_random --straight (os pares só com F, os ímpares com
+# registers.int), em três larguras (a última com unidades de DIV e MUL limitadas), sobre uma
+# grade de RSs, latências e tamanhos de ROB.
+sweeps=0
+sweepFailures=0
+grid="--sweep rs.add=1-3 --sweep rs.load=1-3 --sweep rs.fpadd=1,2 --sweep latency.div=4,40 --sweep latency.load=1,3 --sweep latency.fpdiv=3,25 --sweep rob=4,16"
+for index in 1 2 3 4 5 6; do
+    "$BUILD/cosim_random" --print $index --straight --length 60 > "$BUILD/sweep.txt" || exit 1
+    options=$(sed -n 's/^# //p' "$BUILD/sweep.txt")
+    for width in "" "--issue-width 2 --cdbs 2 --commit-width 2" "--issue-width 4 --cdbs 2 --commit-width 4 --fu div=1,nopipe --fu mul=1"; do
+        sweeps=$((sweeps + 1))
+        : > "$BUILD/single.errors"
+        "$BUILD/tomasulo" "$BUILD/sweep.txt" $options $width $grid --sweep-out "$BUILD/lockstep.csv" 2>"$BUILD/errors" &&
+        "$BUILD/tomasulo" "$BUILD/sweep.txt" $options $width $grid --no-lockstep --sweep-out "$BUILD/single.csv" 2>"$BUILD/single.errors"
+        status=$?
+        if [ $status -ne 0 ]; then
+            echo "FALHA varredura do programa $index ($width): codigo de saida $status"
+            cat "$BUILD/errors" "$BUILD/single.errors" | sed 's/^/    /'
+            sweepFailures=$((sweepFailures + 1))
+        elif ! grep -q "em lote), " "$BUILD/errors" || grep -q "(0 em lote)" "$BUILD/errors"; then
+            echo "FALHA varredura do programa $index ($width): nenhuma configuracao em lote"
+            sweepFailures=$((sweepFailures + 1))
+        elif ! cmp -s "$BUILD/lockstep.csv" "$BUILD/single.csv"; then
+            echo "FALHA varredura do programa $index ($width): CSV em lote diferente do de --no-lockstep"
+            diff "$BUILD/single.csv" "$BUILD/lockstep.csv" | sed 's/^/    /'
+            sweepFailures=$((sweepFailures + 1))
+        fi
+    done
+done
+echo "Varredura em lote: $sweeps grades, $sweepFailures com falha"
+failures=$((failures + sweepFailures))
+
+[ $failures -eq 0 ]
@@ -0,0 +1,295 @@
+// Co-simulação com programas aleatórios: gera programas com laços, desvios e LOADs/STOREs em
+// endereços que se sobrepõem, simula cada um em várias máquinas e modos (um stepSimulation() por
+// ciclo ou pulando os ciclos ociosos, rename = rob ou prf, memory_order conservative ou
+// speculative) com enableCosimulation(), e confere que nenhum commit diverge do modelo de
+// referência e que as instruções cometidas e os registradores finais são os mesmos em todos.
+// Com smt.threads > 1, cada thread executa uma cópia do programa e deve terminar com os
+// registradores da execução isolada. Termina com código 1 se algum programa falhar.
+
+#include "tomasulo.h"
+
+// Gerador pseudo-aleatório próprio (xorshift64*): o mesmo programa para a mesma semente em
+// qualquer compilador, o que as distribuições da biblioteca padrão não garantem.
+class TestRandom {
+public:
+    explicit TestRandom(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+    int below(int n) {
+        state ^= state >> 12; state ^= state << 25; state ^= state >> 27;
+        return static_cast<int>(((state * 0x2545F4914F6CDD1DULL) >> 33) % static_cast<uint64_t>(n));
+    }
+    bool chance(int percent) { return below(100) < percent; }
+
+private:
+    uint64_t state;
+};
+
+// Monta o programa do teste 'index': os pares usam só os F (inteiros, como no modelo original),
+// os ímpares separam os R (inteiros) dos F (doubles), com registers.int = TYPED_INT_REGISTERS.
+// Os LOADs e STOREs usam uma base que nunca é escrita (F0 ou R0), com offsets em uma faixa
+// pequena, para que muitos acessos caiam no mesmo endereço. Os laços contam de 0 até o valor
+// de um registrador que nunca é escrito (10, o valor inicial), então sempre terminam.
+// Com 'straight', não há desvios nem laços (programas que a varredura em lote, LockstepSweep,
+// aceita).
+class RandomProgram {
+public:
+    static const int TYPED_INT_REGISTERS = 11;
+
+    RandomProgram(int index, int length, bool withoutBranches = false)
+        : random(index), typed(index % 2 != 0), straight(withoutBranches), remaining(length) {
+        // O incremento dos laços: R9 = 10 - 9 ou F17 = 10 / 10.
+        emit(typed ? "SUBI R9, R9, #9" : "DIV F17, F17, F17");
+        block(0);
+    }
+
+    bool isTyped() const { return typed; }
+    string text() const { return source.str(); }
+
+private:
+    TestRandom random;
+    bool typed, straight;
+    int remaining; // Instruções que ainda podem ser geradas fora dos laços.
+    int labels = 0;
+    ostringstream source;
+
+    void emit(const string &line) { source << line << '\n'; }
+    string label() { return "L" + to_string(++labels); }
+
+    // Registradores de dados: F1..F12, ou R1..R6 (inteiros) e F0..F7 (doubles).
+    string intData() { return typed ? "R" + to_string(1 + random.below(6)) : "F" + to_string(1 + random.below(12)); }
+    string floatData() { return "F" + to_string(random.below(8)); }
+    string base() const { return typed ? "R0" : "F0"; }
+    // Contador do laço aninhado 'depth', o seu incremento (1) e o limite (10).
+    string counter(int depth) const { return typed ? "R" + to_string(7 + depth) : "F" + to_string(13 + depth); }
+    string one() const { return typed ? "R9" : "F17"; }
+    string bound() const { return typed ? "R10" : "F19"; }
+
+    void instruction() {
+        remaining--;
+        int kind = random.below(100);
+        if (straight && kind >= 60 && kind < 72) kind = 72 + random.below(28); // Sem desvios.
+        if (kind < 20) {
+            static const char *ops[] = {"ADD", "SUB", "ADD", "MUL", "DIV"};
+            emit(string(ops[random.below(5)]) + " " + intData() + ", " + intData() + ", " + intData());
+        } else if (kind < 28 && typed) {
+            emit(string(random.chance(50) ? "ADDI " : "SUBI ") + intData() + ", " + intData() + ", #" + to_string(random.below(40) - 5));
+        } else if (kind < 45) {
+            string data = typed && random.chance(60) ? floatData() : intData();
+            emit("L.D " + data + ", " + to_string(random.below(24)) + "(" + base() + ")");
+        } else if (kind < 60) {
+            string data = typed && random.chance(60) ? floatData() : intData();
+            emit("S.D " + data + ", " + to_string(random.below(24)) + "(" + base() + ")");
+        } else if (kind < 68) {
+            // Desvio para frente sobre algumas instruções.
+            string target = label();
+            emit(string(random.chance(50) ? "BEQ " : "BNE ") + intData() + ", " + intData() + ", " + target);
+            for (int i = random.below(4); i >= 0; --i) instruction();
+            emit(target + ":");
+        } else if (kind < 72) {
+            string target = label();
+            emit("J " + target);
+            instruction();
+            emit(target + ":");
+        } else if (typed) {
+            int op = random.below(10);
+            if (op < 2) emit("CVT.D.W " + floatData() + ", " + intData());
+            else if (op < 3) emit("CVT.W.D " + intData() + ", " + floatData());
+            else {
+                static const char *ops[] = {"ADD.D", "SUB.D", "MUL.D", "DIV.D"};
+                emit(string(ops[random.below(4)]) + " " + floatData() + ", " + floatData() + ", " + floatData());
+            }
+        } else {
+            emit(string(random.chance(50) ? "ADD " : "MUL ") + intData() + ", " + intData() + ", " + intData());
+        }
+    }
+
+    // Sequência de instruções e laços (até dois níveis de aninhamento).
+    void block(int depth) {
+        while (remaining > 0 && (depth == 0 || random.below(6) != 0)) {
+            if (!straight && depth < 2 && random.chance(8)) {
+                string top = label(), count = counter(depth);
+                emit("SUB " + count + ", " + count + ", " + count);
+                emit(top + ":");
+                int saved = remaining;
+                remaining = min(remaining, 8); // O corpo do laço é curto: é repetido 10 vezes.
+                block(depth + 1);
+                remaining = saved - 1;
+                emit("ADD " + count + ", " + count + ", " + one());
+                emit("BNE " + count + ", " + bound() + ", " + top);
+            } else {
+                instruction();
+            }
+        }
+    }
+};
+
+// Uma máquina do teste: um nome e as linhas "chave=valor" aplicadas sobre o padrão.
+struct TestMachine {
+    const char *name;
+    const char *settings;
+};
+
+const TestMachine testMachines[] = {
+    {"padrao", ""},
+    {"pequena", "rob=6 rs.add=1 rs.mul=1 rs.load=1 rs.store=1 rs.fpadd=1 rs.fpmul=1 issue_width=2 cdbs=2 commit_width=2 "
+                "latency.load=3 fu.div=1,nopipe branch.predictor=static"},
+    {"larga", "rob=32 issue_width=4 cdbs=3 commit_width=4 branch.predictor=gshare l1.size=64 l1.line=4 l1.latency=2"},
+};
+const int TEST_MACHINE_COUNT = sizeof(testMachines) / sizeof(testMachines[0]);
+
+inline bool applyTestSettings(MachineConfig &config, const string &settings, string &error) {
+    istringstream fields(settings);
+    string setting;
+    while (fields >> setting) {
+        size_t eq = setting.find('=');
+        if (!applyMachineSetting(config, setting.substr(0, eq), setting.substr(eq + 1), error)) return false;
+    }
+    return validateMachineConfig(config, error);
+}
+
+// Resultado de uma simulação do programa.
+struct TestOutcome {
+    bool loaded = false, complete = false, diverged = false;
+    long long committed = 0;
+    string registers; // Saída de printRegisters().
+    string errors;
+};
+
+// Simula o programa até o fim no simulador recebido de withSimulator.
+struct TestRun {
+    const string &program;
+    bool eventDriven, cosim;
+    TestOutcome outcome;
+    TestRun(const string &source, bool skipIdle, bool check) : program(source), eventDriven(skipIdle), cosim(check) {}
+
+    template <class Simulator> void operator()(Simulator &simulator) {
+        ostringstream output, errors;
+        simulator.setOutput(output, errors);
+        simulator.setCommitLog(false);
+        simulator.setKeepHistory(false);
+        outcome.loaded = simulator.loadProgramText(program);
+        if (!outcome.loaded) { outcome.errors = errors.str(); return; }
+        if (cosim) simulator.enableCosimulation();
+        const int limit = 5000000; // Um programa que não termina é uma falha, não um travamento do teste.
+        if (eventDriven) simulator.runCycles(limit);
+        else while (!simulator.isSimulationComplete() && simulator.getCurrentCycle() < limit) simulator.stepSimulation();
+        outcome.complete = simulator.isSimulationComplete() && !simulator.hasDiverged();
+        outcome.diverged = simulator.hasDiverged();
+        outcome.committed = simulator.getStats().committedInstructions;
+        output.str("");
+        simulator.printRegisters();
+        outcome.registers = output.str();
+        outcome.errors = errors.str();
+    }
+};
+
+// Registradores de uma thread de uma execução SMT, no formato de uma execução isolada.
+inline string threadRegisters(const string &registers, int thread) {
+    string header = " (thread " + to_string(thread) + ")";
+    size_t start = registers.find(header);
+    if (start == string::npos) return "";
+    size_t begin = registers.rfind("\nValores Finais", start);
+    size_t end = registers.find("\nValores Finais", start);
+    string block = registers.substr(begin, (end == string::npos ? registers.size() : end) - begin);
+    return block.erase(block.find(header), header.size());
+}
+
+// Executa o teste 'index' em todas as máquinas e modos. Retorna as falhas (0: passou).
+inline int runRandomTest(int index, int length, bool verbose) {
+    RandomProgram generated(index, length);
+    const string program = generated.text();
+    int failures = 0;
+    TestOutcome first;
+    string firstName;
+    auto fail = [&](const string &where, const string &why) {
+        cerr << "FALHA programa " << index << " (" << where << "): " << why << endl;
+        failures++;
+    };
+
+    for (int m = 0; m < TEST_MACHINE_COUNT; ++m) {
+        for (int mode = 0; mode < 8; ++mode) {
+            bool eventDriven = mode & 1, prf = mode & 2, speculative = mode & 4;
+            MachineConfig config;
+            string settings = testMachines[m].settings, error;
+            if (generated.isTyped()) settings += " registers.int=" + to_string(RandomProgram::TYPED_INT_REGISTERS);
+            settings += prf ? " rename=prf" : " rename=rob";
+            settings += speculative ? " memory_order=speculative" : " memory_order=conservative";
+            string name = string(testMachines[m].name) + (eventDriven ? ", pulando ciclos ociosos" : ", ciclo a ciclo") +
+                          (prf ? ", rename=prf" : ", rename=rob") + (speculative ? ", speculative" : ", conservative");
+            if (!applyTestSettings(config, settings, error)) { fail(name, "maquina invalida: " + error); continue; }
+
+            TestRun run(program, eventDriven, true);
+            withSimulator(config, CORE_AUTO, run);
+            const TestOutcome &outcome = run.outcome;
+            if (!outcome.loaded) { fail(name, "programa nao carregado: " + outcome.errors); return failures; }
+            if (outcome.diverged) { fail(name, "divergencia na co-simulacao:\n" + outcome.errors); continue; }
+            if (!outcome.complete) { fail(name, "nao terminou"); continue; }
+            if (firstName.empty()) { first = outcome; firstName = name; continue; }
+            if (outcome.committed != first.committed) {
+                fail(name, to_string(outcome.committed) + " instrucoes cometidas, " + to_string(first.committed) + " em " + firstName);
+            } else if (outcome.registers != first.registers) {
+                fail(name, "registradores finais diferentes dos de " + firstName);
+            }
+        }
+    }
+
+    // SMT: cópias do programa em cada thread, cada uma com os registradores da execução isolada.
+    for (int threads = 2; threads <= 3; ++threads) {
+        for (int eventDriven = 0; eventDriven < 2; ++eventDriven) {
+            MachineConfig config;
+            string error, settings = "rob=" + to_string(12 * threads) + " smt.threads=" + to_string(threads);
+            if (generated.isTyped()) settings += " registers.int=" + to_string(RandomProgram::TYPED_INT_REGISTERS);
+            string name = "smt.threads=" + to_string(threads) + (eventDriven ? ", pulando ciclos ociosos" : ", ciclo a ciclo");
+            if (!applyTestSettings(config, settings, error)) { fail(name, "maquina invalida: " + error); continue; }
+            TestRun run(program, eventDriven != 0, false);
+            withSimulator(config, CORE_AUTO, run);
+            if (!run.outcome.complete) { fail(name, "nao terminou"); continue; }
+            for (int t = 0; t < threads; ++t) {
+                if (threadRegisters(run.outcome.registers, t) != first.registers) {
+                    fail(name, "registradores finais da thread " + to_string(t) + " diferentes dos de " + firstName);
+                }
+            }
+        }
+    }
+    if (failures > 0 && verbose) cerr << "Programa " << index << ":\n" << program;
+    return failures;
+}
+
+void printTestUsage(const char *program) {
+    cerr << "Uso: " << program << " [--programs N] [--first I] [--length N] [--print I [--straight]]" << endl
+         << "  --programs N  quantidade de programas aleatorios (padrao: 40)" << endl
+         << "  --first I     indice do primeiro programa (padrao: 1); os impares usam registers.int" << endl
+         << "  --length N    instrucoes geradas por programa, sem contar as repeticoes dos lacos (padrao: 80)" << endl
+         << "  --print I     imprime o programa I (para reproduzir uma falha com o simulador) e termina" << endl
+         << "  --straight    com --print, gera o programa sem desvios nem lacos (para a varredura em lote)" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    int programs = 40, first = 1, length = 80, print = -1;
+    bool straight = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--straight") {
+            straight = true;
+            continue;
+        }
+        int *target = arg == "--programs" ? &programs : arg == "--first" ? &first : arg == "--length" ? &length :
+                      arg == "--print" ? &print : nullptr;
+        if (target == nullptr || i + 1 == argc || (*target = atoi(argv[++i])) < 0) {
+            printTestUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (print >= 0) {
+        RandomProgram generated(print, length, straight);
+        if (generated.isTyped()) cout << "# --set registers.int=" << RandomProgram::TYPED_INT_REGISTERS << endl;
+        cout << generated.text();
+        return 0;
+    }
+
+    int failed = 0;
+    for (int index = first; index < first + programs; ++index) {
+        if (runRandomTest(index, length, true) > 0) failed++;
+    }
+    cout << "Co-simulacao aleatoria: " << programs << " programas, " << failed << " com falha" << endl;
+    return failed > 0 ? 1 : 0;
+}
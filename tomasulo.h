@@ -0,0 +1,5359 @@
+// Simulador do Algoritmo de Tomasulo - versão ROB (biblioteca)
+// Todo o simulador fica neste cabeçalho (só funções inline e templates), então basta incluí-lo:
+// cada instância de TomasuloSimulator tem o seu próprio estado, as suas saídas (setOutput) e
+// os seus eventos (setListener), e várias podem rodar em paralelo no mesmo processo.
+// O programa de linha de comando (tomasulo.cpp) é um cliente desta API.
+#ifndef TOMASULO_H
+#define TOMASULO_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <array>   // std::array (armazenamento dos núcleos especializados)
+#include <string>
+#include <sstream> // istringstream, stringstream
+#include <queue>   // std::queue
+#include <deque>   // std::deque (fila de LOADs/STOREs)
+#include <unordered_map> // páginas da memória esparsa
+#include <algorithm> // std::sort
+#include <limits>  // std::numeric_limits (limpar buffer de entrada)
+#include <cstdlib> // atoi, strtoll, strtod
+#include <cerrno>  // errno (estouro em strtoll)
+#include <cstdio>  // FILE, fopen, fwrite (escrita do trace)
+#include <cstdint> // uint8_t, uint16_t, int32_t (formato binário das instruções)
+#include <cstring> // memcmp, memcpy
+#include <cstdarg> // va_list (impressão formatada em 'out')
+#include <type_traits> // enable_if (campos do snapshot por tipo)
+#include <chrono>  // steady_clock (tempo por estágio, setStageProfile)
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h> // mmap: o arquivo binário de instruções é usado direto da memória mapeada.
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define TOMASULO_HAVE_MMAP 1
+#endif
+
+using namespace std;
+
+// Define os tipos de instrução que o simulador consegue processar.
+// Adicionar novos tipos aqui exige expandir a lógica de tratamento (e manter os valores
+// existentes: eles são o opcode do arquivo binário).
+enum InstructionType {
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    LOAD,
+    STORE,
+    BEQ,    // Desvio se Fj == Fk.
+    BNE,    // Desvio se Fj != Fk.
+    JUMP,   // Salto incondicional ("J ROTULO").
+    ADDI,   // Soma com imediato ("ADDI R1, R1, 8"): o imediato ocupa o lugar de src2.
+    SUBI,   // Subtração do imediato.
+    ADD_D,  // Ponto flutuante de precisão dupla (ADD.D, SUB.D, MUL.D, DIV.D), sobre registradores F.
+    SUB_D,
+    MUL_D,
+    DIV_D,
+    CVT_D_W, // Inteiro -> ponto flutuante ("CVT.D.W F2, R1").
+    CVT_W_D, // Ponto flutuante -> inteiro, truncando ("CVT.W.D R1, F2").
+    INVALID // Para casos de erro ou instruções não reconhecidas.
+};
+
+// Nome (mnemônico) de cada tipo de instrução.
+inline const char *instructionTypeName(InstructionType type) {
+    static const char *names[] = {"ADD", "SUB", "MUL", "DIV", "LOAD", "STORE", "BEQ", "BNE", "J",
+                                  "ADDI", "SUBI", "ADD.D", "SUB.D", "MUL.D", "DIV.D", "CVT.D.W", "CVT.W.D", "INV"};
+    return names[type];
+}
+
+// Desvios condicionais (BEQ/BNE) e o salto incondicional: mudam o fluxo da busca.
+inline bool isControlFlow(InstructionType type) { return type == BEQ || type == BNE || type == JUMP; }
+
+// Operações com imediato no lugar do segundo registrador.
+inline bool usesImmediate(InstructionType type) { return type == ADDI || type == SUBI; }
+
+// Operações de ponto flutuante (inclui as conversões): usam as unidades fpadd, fpmul e fpdiv.
+inline bool isFloatingPoint(InstructionType type) { return type >= ADD_D && type <= CVT_W_D; }
+
+// Conversões entre inteiro e ponto flutuante: um só operando-fonte (src1).
+inline bool isConversion(InstructionType type) { return type == CVT_D_W || type == CVT_W_D; }
+
+// Palavra da máquina (registradores, ROB, RSs, CDB e memória): 64 bits, com um inteiro ou o
+// padrão de bits de um double IEEE-754 (os registradores F com registers.int > 0).
+typedef int64_t Word;
+
+inline double wordToDouble(Word word) { double value; memcpy(&value, &word, sizeof(value)); return value; }
+inline Word doubleToWord(double value) { Word word; memcpy(&word, &value, sizeof(word)); return word; }
+// Palavra de um resultado de ponto flutuante. Todo NaN vira o NaN canônico (0x7FF8000000000000):
+// o sinal e os bits de um NaN calculado dependem de qual operando o compilador põe primeiro, e o
+// pipeline e o modelo de referência precisam gravar a mesma palavra.
+inline Word floatResultWord(double value) { return value != value ? static_cast<Word>(0x7FF8000000000000LL) : doubleToWord(value); }
+
+// Texto de uma palavra: o inteiro ou, com 'asDouble', o double mais curto que volta ao mesmo
+// valor, sempre com ponto ou expoente ("10.0", "0.1", "1e+20", "inf").
+inline string wordText(Word word, bool asDouble) {
+    if (!asDouble) return to_string(word);
+    double value = wordToDouble(word);
+    char text[32];
+    snprintf(text, sizeof(text), "%.15g", value);
+    if (strtod(text, nullptr) != value && value == value) snprintf(text, sizeof(text), "%.17g", value);
+    string result = text;
+    if (result.find_first_of(".en") == string::npos) result += ".0";
+    return result;
+}
+
+// Resultado de uma operação aritmética (inteira, com imediato ou de ponto flutuante) sobre
+// 'a' (src1) e 'b' (src2 ou o imediato). A mesma semântica no WriteResult, no modo funcional e
+// no modelo de referência. As inteiras são de 64 bits e dão a volta no estouro (complemento de 2);
+// a divisão inteira por zero resulta 0 (quem executa reporta o erro). As de ponto flutuante seguem
+// o IEEE (infinito ou o NaN canônico); CVT.W.D trunca, satura fora da faixa e leva NaN a 0.
+inline Word arithmeticResult(InstructionType type, Word a, Word b) {
+    uint64_t ua = static_cast<uint64_t>(a), ub = static_cast<uint64_t>(b); // Sem sinal: o estouro não é indefinido.
+    switch (type) {
+        case ADD: case ADDI: return static_cast<Word>(ua + ub);
+        case SUB: case SUBI: return static_cast<Word>(ua - ub);
+        case MUL: return static_cast<Word>(ua * ub);
+        case DIV:
+            if (b == 0) return 0;
+            return b == -1 ? static_cast<Word>(0 - ua) : a / b; // INT64_MIN / -1 também dá a volta.
+        case ADD_D: return floatResultWord(wordToDouble(a) + wordToDouble(b));
+        case SUB_D: return floatResultWord(wordToDouble(a) - wordToDouble(b));
+        case MUL_D: return floatResultWord(wordToDouble(a) * wordToDouble(b));
+        case DIV_D: return floatResultWord(wordToDouble(a) / wordToDouble(b));
+        case CVT_D_W: return doubleToWord(static_cast<double>(a));
+        case CVT_W_D: {
+            double value = wordToDouble(a);
+            if (value != value) return 0; // NaN.
+            if (value >= 9223372036854775808.0) return numeric_limits<Word>::max();
+            if (value <= -9223372036854775808.0) return numeric_limits<Word>::min();
+            return static_cast<Word>(value);
+        }
+        default: return 0;
+    }
+}
+
+// Endereço de um LOAD/STORE: 'offset' mais o valor da base. Fora da faixa de int (e, portanto,
+// da memória), -1.
+inline int effectiveAddress(int offset, Word base) {
+    Word address = static_cast<Word>(static_cast<uint64_t>(base) + static_cast<uint64_t>(static_cast<Word>(offset)));
+    return address >= numeric_limits<int>::min() && address <= numeric_limits<int>::max() ? static_cast<int>(address) : -1;
+}
+
+// Estados possíveis para uma entrada no Reorder Buffer (ROB).
+// Isso ajuda a rastrear o ciclo de vida de cada instrução.
+enum ROBState {
+    ROB_EMPTY,      // Indica que a entrada do ROB está disponível para uso.
+    ROB_ISSUE,      // A instrução foi alocada no ROB, aguardando recursos ou operandos.
+    ROB_EXECUTE,    // A instrução está sendo processada por uma unidade funcional.
+    ROB_WRITERESULT,// O resultado foi calculado e escrito no ROB, aguardando o commit.
+    // O estado de COMMIT é mais um evento; após ele, a entrada volta a ser ROB_EMPTY.
+};
+
+// Marca um campo de registrador que não é usado pela instrução.
+const uint16_t NO_REGISTER = 0xFFFF;
+
+// Classes de registradores: os F (F0, F1, ...) são numerados a partir de 0 e os inteiros
+// (R0, R1, ...) têm o bit INT_REGISTER_BIT ligado, então o número na instrução não depende
+// da quantidade de registradores de cada classe.
+const uint16_t INT_REGISTER_BIT = 0x8000;
+
+// Índice de um registrador no banco da máquina, onde os F0..F{fpCount-1} vêm seguidos dos
+// R0, R1, ... (-1 para NO_REGISTER).
+inline int registerIndex(uint16_t reg, int fpCount) {
+    return reg < INT_REGISTER_BIT ? reg : reg == NO_REGISTER ? -1 : fpCount + (reg - INT_REGISTER_BIT);
+}
+
+// Instrução decodificada: opcode numérico, números dos registradores e o imediato.
+// Tem exatamente o layout de um registro do arquivo binário de instruções (12 bytes),
+// então um arquivo mapeado em memória é usado diretamente, sem conversão.
+struct DecodedInstruction {
+    uint8_t op;     // InstructionType.
+    uint8_t flags;  // Reservado (0).
+    uint16_t dest;  // Registrador de destino. NO_REGISTER para STORE e desvios.
+    uint16_t src1;  // Primeiro operando. NO_REGISTER para LOAD e J; em STORE, o registrador com o dado.
+    uint16_t src2;  // Segundo operando. Em LOAD/STORE, o registrador base. NO_REGISTER em J, ADDI/SUBI e CVT.
+    int32_t imm;    // Offset de LOAD/STORE; nos desvios, o alvo (índice da instrução); o imediato de ADDI/SUBI.
+                    // 0 nas demais aritméticas.
+
+    InstructionType type() const { return static_cast<InstructionType>(op); }
+    // Registradores como int (o número na instrução, ver INT_REGISTER_BIT), com -1 para "não usado".
+    int destReg() const { return dest == NO_REGISTER ? -1 : dest; }
+    int src1Reg() const { return src1 == NO_REGISTER ? -1 : src1; }
+    int src2Reg() const { return src2 == NO_REGISTER ? -1 : src2; }
+
+    template <class Archive> void transfer(Archive &ar) { ar(op); ar(flags); ar(dest); ar(src1); ar(src2); ar(imm); }
+};
+static_assert(sizeof(DecodedInstruction) == 12, "DecodedInstruction deve ter o layout do registro binario");
+
+// Informações de timing dos estágios do pipeline de uma instrução.
+// O que a instrução faz fica em DecodedInstruction (ver Program).
+struct Instruction {
+    int issue = -1;              // Ciclo de emissão da instrução. -1 se ainda não emitida.
+    int execComp = -1;           // Ciclo de conclusão da execução. -1 se não concluída.
+    int writeResult = -1;        // Ciclo de escrita do resultado no ROB (via CDB). -1 se não escrito.
+    int commitCycle = -1;        // Ciclo de commit da instrução. -1 se não cometido.
+
+    template <class Archive> void transfer(Archive &ar) { ar(issue); ar(execComp); ar(writeResult); ar(commitCycle); }
+};
+
+// Converte o nome de um registrador ("F12", "R3") em seu número na instrução (12, INT_REGISTER_BIT | 3).
+// Retorna -1 se o nome não for um registrador válido para 'registerCount' registradores F e
+// 'intRegisterCount' registradores R.
+inline int parseRegisterName(const string &name, int registerCount, int intRegisterCount = 0) {
+    if (name.size() < 2 || (name[0] != 'F' && name[0] != 'R')) return -1;
+    int limit = name[0] == 'F' ? registerCount : intRegisterCount;
+    int number = 0;
+    for (size_t i = 1; i < name.size(); ++i) {
+        if (name[i] < '0' || name[i] > '9') return -1;
+        number = number * 10 + (name[i] - '0');
+        if (number >= limit) return -1;
+    }
+    return name[0] == 'F' ? number : INT_REGISTER_BIT | number;
+}
+
+// Nome do registrador a partir do seu número na instrução (12 -> "F12", INT_REGISTER_BIT | 3 -> "R3").
+inline string registerNameOf(int reg) {
+    return reg >= INT_REGISTER_BIT ? "R" + to_string(reg - INT_REGISTER_BIT) : "F" + to_string(reg);
+}
+
+// Classes de registradores exigidas pela instrução. Com 'intRegisterCount' = 0 só há os F, que
+// guardam inteiros, e não há operações de ponto flutuante. Com registradores R, os F passam a ser
+// de ponto flutuante (double): as operações inteiras, os desvios e a base de LOAD/STORE usam R;
+// as .D, F; CVT.D.W vai de R para F e CVT.W.D de F para R. O destino do LOAD e o dado do STORE
+// podem ser de qualquer classe (a memória guarda palavras). Retorna o motivo, ou nullptr se 'inst' as respeita.
+inline const char *registerClassError(const DecodedInstruction &inst, int intRegisterCount) {
+    auto isF = [](uint16_t reg) { return reg < INT_REGISTER_BIT; };
+    auto isR = [](uint16_t reg) { return reg != NO_REGISTER && reg >= INT_REGISTER_BIT; };
+    InstructionType type = inst.type();
+    if (intRegisterCount == 0) return isFloatingPoint(type) ? "Operacao de ponto flutuante exige registers.int > 0" : nullptr;
+    switch (type) {
+        case ADD: case SUB: case MUL: case DIV:
+            return isR(inst.dest) && isR(inst.src1) && isR(inst.src2) ? nullptr : "Operacao inteira exige registradores R";
+        case ADDI: case SUBI: return isR(inst.dest) && isR(inst.src1) ? nullptr : "Operacao inteira exige registradores R";
+        case ADD_D: case SUB_D: case MUL_D: case DIV_D:
+            return isF(inst.dest) && isF(inst.src1) && isF(inst.src2) ? nullptr : "Operacao de ponto flutuante exige registradores F";
+        case CVT_D_W: return isF(inst.dest) && isR(inst.src1) ? nullptr : "CVT.D.W exige destino F e fonte R";
+        case CVT_W_D: return isR(inst.dest) && isF(inst.src1) ? nullptr : "CVT.W.D exige destino R e fonte F";
+        case BEQ: case BNE: return isR(inst.src1) && isR(inst.src2) ? nullptr : "Desvio exige registradores R";
+        case LOAD: case STORE: return isR(inst.src2) ? nullptr : "Base de LOAD/STORE exige registrador R";
+        default: return nullptr;
+    }
+}
+
+// Texto da instrução decodificada (ex: "ADD F1,F2,F3", "LOAD F1,100(F2)", "ADDI R1,R1,8").
+inline string decodedInstructionText(const DecodedInstruction &inst) {
+    string name = instructionTypeName(inst.type());
+    switch (inst.type()) {
+        case ADD: case SUB: case MUL: case DIV: case ADD_D: case SUB_D: case MUL_D: case DIV_D:
+            return name + " " + registerNameOf(inst.dest) + "," + registerNameOf(inst.src1) + "," + registerNameOf(inst.src2);
+        case ADDI: case SUBI: return name + " " + registerNameOf(inst.dest) + "," + registerNameOf(inst.src1) + "," + to_string(inst.imm);
+        case CVT_D_W: case CVT_W_D: return name + " " + registerNameOf(inst.dest) + "," + registerNameOf(inst.src1);
+        case LOAD: return name + " " + registerNameOf(inst.dest) + "," + to_string(inst.imm) + "(" + registerNameOf(inst.src2) + ")";
+        case STORE: return name + " " + registerNameOf(inst.src1) + "," + to_string(inst.imm) + "(" + registerNameOf(inst.src2) + ")";
+        case BEQ: case BNE: return name + " " + registerNameOf(inst.src1) + "," + registerNameOf(inst.src2) + "," + to_string(inst.imm);
+        case JUMP: return name + " " + to_string(inst.imm);
+        default: return "INVALID";
+    }
+}
+
+// Cabeçalho do arquivo binário de instruções. Depois dele vêm 'count' registros
+// DecodedInstruction. Os campos estão na ordem de bytes da máquina (little-endian nas usuais).
+struct BinaryProgramHeader {
+    char magic[4];     // "TOMB".
+    uint32_t version;  // BINARY_PROGRAM_VERSION.
+    uint64_t count;    // Quantidade de instruções.
+};
+static_assert(sizeof(BinaryProgramHeader) == 16, "cabecalho binario deve ter 16 bytes");
+const char BINARY_PROGRAM_MAGIC[4] = {'T', 'O', 'M', 'B'};
+const uint32_t BINARY_PROGRAM_VERSION = 1;
+
+// Programa decodificado. As instruções vêm do parser de texto (guardadas em 'owned')
+// ou de um arquivo binário mapeado em memória (mmap), usado sem cópia. Sem mmap
+// (plataformas não POSIX), o arquivo binário é lido de uma vez para 'owned'.
+class Program {
+private:
+    vector<DecodedInstruction> owned;
+    const DecodedInstruction *records = nullptr;
+    size_t count = 0;
+    void *mapping = nullptr;  // Região mapeada (cabeçalho + registros), ou nullptr.
+    size_t mappingSize = 0;
+
+    void releaseMapping() {
+#ifdef TOMASULO_HAVE_MMAP
+        if (mapping) munmap(mapping, mappingSize);
+#endif
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+
+public:
+    Program() {}
+    ~Program() { releaseMapping(); }
+    Program(const Program &) = delete;
+    Program &operator=(const Program &) = delete;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool isMapped() const { return mapping != nullptr; }
+    const DecodedInstruction &operator[](size_t i) const { return records[i]; }
+
+    void append(const DecodedInstruction &inst) {
+        if (mapping) { // Passa a ser dono dos registros antes de modificar.
+            owned.assign(records, records + count);
+            releaseMapping();
+        }
+        owned.push_back(inst);
+        records = owned.data();
+        count = owned.size();
+    }
+
+    // Decodifica uma linha do arquivo de texto. Retorna false se a linha não contém uma
+    // instrução (vazia, comentário) ou é inválida; nesse caso o erro já foi impresso.
+    // Em um desvio, o rótulo de destino vai para 'targetLabel' (o alvo é resolvido por
+    // loadText); sem 'targetLabel' (modo streaming), desvios são inválidos. Os registradores
+    // válidos são F0..F{registerCount-1} e R0..R{intRegisterCount-1}, nas classes de registerClassError().
+    static bool decodeLine(const string &line, DecodedInstruction &inst, int registerCount, int intRegisterCount, ostream &err,
+                           string *targetLabel = nullptr) {
+        if (line.empty() || line[0] == '#') return false; // Ignora linhas vazias ou comentários no arquivo de entrada.
+
+        istringstream iss(line); // Para facilitar o parsing da linha.
+        string op, p1, p2, p3;   // Tokens temporários para os operandos.
+        iss >> op >> p1;         // Lê a operação e o primeiro parâmetro.
+        if (!p1.empty() && p1.back() == ',') p1.pop_back(); // Remove vírgula, se houver.
+
+        inst = {INVALID, 0, NO_REGISTER, NO_REGISTER, NO_REGISTER, 0};
+        int destReg = -1, src1Reg = -1, src2Reg = -1; // Registradores resolvidos (-1 = não usado).
+        auto parseReg = [&](const string &name) { return parseRegisterName(name, registerCount, intRegisterCount); };
+        // Parseia a instrução com base no mnemônico da operação.
+        if (op == "ADD" || op == "SUB" || op == "MUL" || op == "DIV" ||
+            op == "ADD.D" || op == "SUB.D" || op == "MUL.D" || op == "DIV.D") { // Instruções aritméticas.
+            if (op == "ADD") inst.op = ADD;
+            else if (op == "SUB") inst.op = SUB;
+            else if (op == "MUL") inst.op = MUL;
+            else if (op == "DIV") inst.op = DIV;
+            else if (op == "ADD.D") inst.op = ADD_D;
+            else if (op == "SUB.D") inst.op = SUB_D;
+            else if (op == "MUL.D") inst.op = MUL_D;
+            else if (op == "DIV.D") inst.op = DIV_D;
+            iss >> p2 >> p3; // Lê os outros dois operandos.
+            if (!p2.empty() && p2.back() == ',') p2.pop_back(); // Remove vírgula.
+            destReg = parseReg(p1); src1Reg = parseReg(p2); src2Reg = parseReg(p3);
+            if (destReg < 0 || src1Reg < 0 || src2Reg < 0) {
+                err << "Registrador invalido na linha: " << line << endl; return false;
+            }
+        } else if (op == "ADDI" || op == "SUBI") { // Com imediato: "ADDI R1, R2, 8" (ou "#8").
+            inst.op = op == "ADDI" ? ADDI : SUBI;
+            iss >> p2 >> p3;
+            if (!p2.empty() && p2.back() == ',') p2.pop_back();
+            if (!p3.empty() && p3[0] == '#') p3.erase(0, 1);
+            destReg = parseReg(p1); src1Reg = parseReg(p2);
+            if (destReg < 0 || src1Reg < 0) { err << "Registrador invalido na linha: " << line << endl; return false; }
+            char *end = nullptr;
+            long value = strtol(p3.c_str(), &end, 10);
+            if (p3.empty() || *end != '\0' || value < numeric_limits<int32_t>::min() || value > numeric_limits<int32_t>::max()) {
+                err << "Imediato invalido na linha: " << line << endl; return false;
+            }
+            inst.imm = static_cast<int32_t>(value);
+        } else if (op == "CVT.D.W" || op == "CVT.W.D") { // Conversões: "CVT.D.W F2, R1" e "CVT.W.D R1, F2".
+            inst.op = op == "CVT.D.W" ? CVT_D_W : CVT_W_D;
+            iss >> p2;
+            destReg = parseReg(p1); src1Reg = parseReg(p2);
+            if (destReg < 0 || src1Reg < 0) { err << "Registrador invalido na linha: " << line << endl; return false; }
+        } else if (op == "L.D" || op == "LOAD") { // Instrução de Load.
+            inst.op = LOAD;
+            iss >> p2;      // p2 é a string "offset(baseReg)".
+            // Extrai offset e registrador base da string p2.
+            size_t openParen = p2.find('('), closeParen = p2.find(')');
+            if (openParen != string::npos && closeParen != string::npos && closeParen > openParen + 1) {
+                inst.imm = atoi(p2.substr(0, openParen).c_str()); // Offset.
+                src2Reg = parseReg(p2.substr(openParen + 1, closeParen - openParen - 1)); // Registrador base.
+            } else { /* Formato inválido. */ err << "Formato L.D invalido: " << p2 << " na linha: "<< line << endl; return false; }
+            destReg = parseReg(p1); // p1 é o registrador de destino.
+            if (destReg < 0 || src2Reg < 0) { err << "Registrador invalido na linha: " << line << endl; return false; }
+        } else if (op == "S.D" || op == "STORE") { // Instrução de Store.
+            inst.op = STORE;
+            iss >> p2;      // p2 é "offset(baseReg)".
+            // Extrai offset e registrador base.
+            size_t openParen = p2.find('('), closeParen = p2.find(')');
+            if (openParen != string::npos && closeParen != string::npos && closeParen > openParen +1) {
+                inst.imm = atoi(p2.substr(0, openParen).c_str()); // Offset.
+                src2Reg = parseReg(p2.substr(openParen + 1, closeParen - openParen - 1)); // Registrador base.
+            } else { /* Formato inválido. */ err << "Formato S.D invalido: " << p2 << " na linha: " << line << endl; return false; }
+            src1Reg = parseReg(p1); // p1 é o registrador do dado a ser armazenado.
+            if (src1Reg < 0 || src2Reg < 0) { err << "Registrador invalido na linha: " << line << endl; return false; }
+        } else if (op == "BEQ" || op == "BNE" || op == "J") { // Desvios: "BEQ Rj, Rk, ROTULO" e "J ROTULO".
+            inst.op = op == "BEQ" ? BEQ : op == "BNE" ? BNE : JUMP;
+            string label = p1;
+            if (inst.op != JUMP) {
+                iss >> p2 >> label;
+                if (!p2.empty() && p2.back() == ',') p2.pop_back();
+                src1Reg = parseReg(p1); src2Reg = parseReg(p2);
+                if (src1Reg < 0 || src2Reg < 0) { err << "Registrador invalido na linha: " << line << endl; return false; }
+            }
+            if (label.empty()) { err << "Desvio sem rotulo de destino na linha: " << line << endl; return false; }
+            if (!targetLabel) { err << "Desvio nao suportado nesta leitura na linha: " << line << endl; return false; }
+            *targetLabel = label;
+        } else { // Operação não reconhecida.
+            err << "Instrucao nao reconhecida: " << op << " na linha: " << line << endl;
+            return false; // Pula para a próxima linha.
+        }
+        if (destReg >= 0) inst.dest = static_cast<uint16_t>(destReg);
+        if (src1Reg >= 0) inst.src1 = static_cast<uint16_t>(src1Reg);
+        if (src2Reg >= 0) inst.src2 = static_cast<uint16_t>(src2Reg);
+        if (const char *classError = registerClassError(inst, intRegisterCount)) {
+            err << classError << " na linha: " << line << endl; return false;
+        }
+        return true;
+    }
+
+    // Lê e decodifica um arquivo de texto inteiro. Linhas inválidas são reportadas em 'err' e ignoradas.
+    // Uma linha pode começar com um rótulo ("LOOP:" ou "LOOP: ADD F1, F2, F3"), que marca a instrução
+    // seguinte; os alvos dos desvios são resolvidos no fim, então um rótulo pode vir depois do desvio.
+    // Um rótulo desconhecido ou repetido é um erro (retorna false).
+    bool loadText(const string &path, int registerCount, int intRegisterCount, ostream &err) {
+        ifstream file(path.c_str()); // Tenta abrir o arquivo.
+        if (!file.is_open()) {
+            err << "Erro ao abrir arquivo: " << path << endl;
+            return false;
+        }
+        return readText(file, path, registerCount, intRegisterCount, err);
+    }
+
+    // Lê as instruções em texto de 'input' (mesmo formato de loadText). 'name' identifica a
+    // origem nas mensagens de erro.
+    bool readText(istream &input, const string &name, int registerCount, int intRegisterCount, ostream &err) {
+        string line; // Para ler cada linha do arquivo.
+        DecodedInstruction inst;
+        unordered_map<string, int> labels;         // Rótulo -> índice da instrução marcada.
+        struct PendingTarget { size_t index; string label; int line; };
+        vector<PendingTarget> pendingTargets;      // Desvios com o alvo ainda a resolver.
+        for (int lineNumber = 1; getline(input, line); ++lineNumber) {
+            size_t first = line.find_first_not_of(" \t");
+            size_t colon = line.find(':');
+            if (first != string::npos && line[first] != '#' && colon != string::npos &&
+                line.find_first_of(" \t,(", first) > colon) { // O primeiro token termina em ':'.
+                string label = line.substr(first, colon - first);
+                if (!labels.insert(make_pair(label, static_cast<int>(count))).second) {
+                    err << name << ":" << lineNumber << ": rotulo repetido: " << label << endl;
+                    return false;
+                }
+                line = line.substr(colon + 1);
+                if (line.find_first_not_of(" \t\r") == string::npos) continue; // Rótulo sozinho na linha.
+            }
+            string target;
+            if (!decodeLine(line, inst, registerCount, intRegisterCount, err, &target)) continue;
+            if (isControlFlow(inst.type())) pendingTargets.push_back({count, target, lineNumber});
+            append(inst); // Adiciona a instrução decodificada.
+        }
+        for (size_t i = 0; i < pendingTargets.size(); ++i) {
+            unordered_map<string, int>::const_iterator label = labels.find(pendingTargets[i].label);
+            if (label == labels.end()) {
+                err << name << ":" << pendingTargets[i].line << ": rotulo desconhecido: " << pendingTargets[i].label << endl;
+                return false;
+            }
+            owned[pendingTargets[i].index].imm = label->second;
+        }
+        return true;
+    }
+
+    // O programa tem desvios?
+    bool hasControlFlow() const {
+        for (size_t i = 0; i < count; ++i) if (isControlFlow(records[i].type())) return true;
+        return false;
+    }
+
+    // O arquivo de texto tem desvios ou rótulos? (verificação rápida, sem decodificar as instruções)
+    static bool textHasControlFlow(const string &path) {
+        ifstream file(path.c_str());
+        string line, op;
+        while (getline(file, line)) {
+            istringstream iss(line);
+            if (!(iss >> op) || op[0] == '#') continue;
+            if (op.find(':') != string::npos || op == "BEQ" || op == "BNE" || op == "J") return true;
+        }
+        return false;
+    }
+
+    // Índice da primeira instrução inválida para 'registerCount' registradores F e 'intRegisterCount'
+    // registradores R (opcode desconhecido, registrador fora do banco ou da classe exigida, operando
+    // que a instrução não usa preenchido, ou desvio para fora do programa), ou -1 se todas são válidas.
+    // O alvo pode ser o fim do programa (o desvio então termina a execução).
+    long long findInvalidInstruction(int registerCount, int intRegisterCount) const {
+        auto validReg = [&](uint16_t reg) {
+            return reg < INT_REGISTER_BIT ? reg < registerCount : reg != NO_REGISTER && reg - INT_REGISTER_BIT < intRegisterCount;
+        };
+        for (size_t i = 0; i < count; ++i) {
+            const DecodedInstruction &inst = records[i];
+            bool valid = inst.op < INVALID;
+            InstructionType type = inst.type();
+            bool noDest = type == STORE || isControlFlow(type);
+            if (valid && !noDest) valid = validReg(inst.dest);
+            else if (valid) valid = inst.dest == NO_REGISTER;
+            if (valid && type != LOAD && type != JUMP) valid = validReg(inst.src1);
+            if (valid && (usesImmediate(type) || isConversion(type))) valid = inst.src2 == NO_REGISTER;
+            else if (valid && type != JUMP) valid = validReg(inst.src2);
+            if (valid) valid = registerClassError(inst, intRegisterCount) == nullptr;
+            if (valid && isControlFlow(type)) valid = inst.imm >= 0 && static_cast<size_t>(inst.imm) <= count;
+            if (!valid) return static_cast<long long>(i);
+        }
+        return -1;
+    }
+
+    // O arquivo começa com o cabeçalho binário?
+    static bool isBinaryFile(const string &path) {
+        ifstream file(path.c_str(), ios::binary);
+        char magic[4];
+        return file.read(magic, sizeof(magic)) && memcmp(magic, BINARY_PROGRAM_MAGIC, sizeof(magic)) == 0;
+    }
+
+    // Grava o programa no formato binário.
+    bool saveBinary(const string &path) const {
+        ofstream file(path.c_str(), ios::binary | ios::trunc);
+        if (!file.is_open()) return false;
+        BinaryProgramHeader header;
+        memcpy(header.magic, BINARY_PROGRAM_MAGIC, sizeof(header.magic));
+        header.version = BINARY_PROGRAM_VERSION;
+        header.count = count;
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        if (count > 0) file.write(reinterpret_cast<const char *>(records), count * sizeof(DecodedInstruction));
+        return static_cast<bool>(file);
+    }
+
+    // Carrega um arquivo binário. Em caso de erro, 'error' descreve o problema.
+    bool loadBinary(const string &path, string &error) {
+        releaseMapping();
+        owned.clear();
+        records = nullptr;
+        count = 0;
+#ifdef TOMASULO_HAVE_MMAP
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) { error = "nao foi possivel abrir o arquivo"; return false; }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(BinaryProgramHeader)) {
+            close(fd);
+            error = "arquivo menor que o cabecalho";
+            return false;
+        }
+        size_t fileSize = static_cast<size_t>(info.st_size);
+        void *region = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // O mapeamento continua válido sem o descritor.
+        if (region == MAP_FAILED) { error = "falha no mmap"; return false; }
+        mapping = region;
+        mappingSize = fileSize;
+        const BinaryProgramHeader *header = static_cast<const BinaryProgramHeader *>(region);
+        if (!validHeader(*header, fileSize, error)) { releaseMapping(); return false; }
+        records = reinterpret_cast<const DecodedInstruction *>(static_cast<const char *>(region) + sizeof(BinaryProgramHeader));
+        count = static_cast<size_t>(header->count);
+#else
+        ifstream file(path.c_str(), ios::binary | ios::ate);
+        if (!file.is_open()) { error = "nao foi possivel abrir o arquivo"; return false; }
+        size_t fileSize = static_cast<size_t>(file.tellg());
+        file.seekg(0);
+        BinaryProgramHeader header;
+        if (fileSize < sizeof(header) || !file.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+            error = "arquivo menor que o cabecalho";
+            return false;
+        }
+        if (!validHeader(header, fileSize, error)) return false;
+        owned.resize(static_cast<size_t>(header.count));
+        if (!owned.empty() && !file.read(reinterpret_cast<char *>(owned.data()), owned.size() * sizeof(DecodedInstruction))) {
+            error = "falha na leitura dos registros";
+            owned.clear();
+            return false;
+        }
+        records = owned.data();
+        count = owned.size();
+#endif
+        return true;
+    }
+
+private:
+    static bool validHeader(const BinaryProgramHeader &header, size_t fileSize, string &error) {
+        if (memcmp(header.magic, BINARY_PROGRAM_MAGIC, sizeof(header.magic)) != 0) { error = "assinatura invalida"; return false; }
+        if (header.version != BINARY_PROGRAM_VERSION) { error = "versao nao suportada " + to_string(header.version); return false; }
+        if ((fileSize - sizeof(BinaryProgramHeader)) / sizeof(DecodedInstruction) != header.count ||
+            (fileSize - sizeof(BinaryProgramHeader)) % sizeof(DecodedInstruction) != 0) {
+            error = "tamanho do arquivo nao corresponde a quantidade de instrucoes";
+            return false;
+        }
+        return true;
+    }
+};
+
+// Detalhes de uma entrada no Reorder Buffer (ROB).
+// O ROB é fundamental para garantir a finalização em ordem e o tratamento de exceções.
+struct ReorderBufferEntry {
+    bool busy = false;              // Esta entrada do ROB está em uso?
+    int instructionIndex = -1;      // Qual instrução (do vetor 'instructions') está aqui?
+    InstructionType type = INVALID; // Tipo da instrução nesta entrada.
+    ROBState state = ROB_EMPTY;     // Estado atual desta instrução no ROB.
+    int destinationRegister = -1;   // Número do registrador de destino arquitetural (ex: 1 para F1). -1 para STORE.
+    Word value = 0;                 // Resultado (ALU/LOAD), dado a ser armazenado (STORE) ou desvio tomado (1/0).
+    int address = 0;                // Endereço de memória (para LOAD/STORE) após cálculo.
+    bool valueReady = false;        // O campo 'value' (resultado/dado do store) já está disponível?
+    // Fila de LOADs/STOREs (fora do modo memory_order = none).
+    bool addressReady = false;      // LOAD/STORE: o endereço efetivo já foi calculado (base pronta)?
+    bool memoryAccessed = false;    // LOAD: o valor já foi lido (em 'value'), da memória ou de um STORE?
+    int forwardedFrom = -1;         // LOAD: instrução STORE que forneceu o valor (-1: lido da memória).
+    // rename = prf: o resultado vai para o registrador físico, não para 'value'.
+    int physicalRegister = -1;      // Registrador físico alocado para o destino (-1: sem destino ou rename = rob).
+    int previousPhysical = -1;      // Mapeamento anterior do destino: liberado no commit, restaurado no descarte.
+
+    template <class Archive> void transfer(Archive &ar) {
+        ar(busy); ar(instructionIndex); ar(type); ar(state); ar(destinationRegister); ar(value); ar(address);
+        ar(valueReady); ar(addressReady); ar(memoryAccessed); ar(forwardedFrom); ar(physicalRegister); ar(previousPhysical);
+    }
+};
+
+// Grupos de Estações de Reserva. Cada grupo atende um conjunto de tipos de instrução.
+// As operações de ponto flutuante têm as suas próprias RSs, as do somador e do multiplicador
+// de ponto flutuante do Hennessy & Patterson.
+enum RSGroup {
+    RS_ADD,   // ADD, SUB, ADDI, SUBI e os desvios condicionais (a comparação usa o somador).
+    RS_MUL,   // MUL e DIV.
+    RS_LOAD,
+    RS_STORE,
+    RS_FPADD, // ADD.D, SUB.D e as conversões.
+    RS_FPMUL, // MUL.D e DIV.D.
+    RS_NONE   // Nenhuma RS livre / grupo inexistente.
+};
+const int RS_GROUP_COUNT = RS_NONE; // Quantidade de grupos reais de RS.
+
+// Nome de cada grupo de RS (usado no trace, ex: "add0" é a primeira RS de ADD/SUB).
+inline const char *rsGroupName(RSGroup group) {
+    static const char *names[] = {"add", "mul", "load", "store", "fpadd", "fpmul", "none"};
+    return names[group];
+}
+
+// Tipos de unidade funcional. MUL e DIV (e MUL.D e DIV.D) compartilham as RSs, mas usam unidades diferentes.
+enum FUType {
+    FU_ADD,   // ADD, SUB, ADDI, SUBI, BEQ e BNE.
+    FU_MUL,
+    FU_DIV,
+    FU_LOAD,  // Porta de leitura da memória.
+    FU_STORE, // Porta de escrita da memória.
+    FU_FPADD, // ADD.D, SUB.D e as conversões.
+    FU_FPMUL,
+    FU_FPDIV,
+    FU_TYPE_COUNT
+};
+
+// Unidade funcional usada por cada tipo de instrução.
+inline FUType functionalUnitFor(InstructionType type) {
+    switch (type) {
+        case MUL: return FU_MUL;
+        case DIV: return FU_DIV;
+        case LOAD: return FU_LOAD;
+        case STORE: return FU_STORE;
+        case ADD_D: case SUB_D: case CVT_D_W: case CVT_W_D: return FU_FPADD;
+        case MUL_D: return FU_FPMUL;
+        case DIV_D: return FU_FPDIV;
+        default: return FU_ADD;
+    }
+}
+
+// Nome de cada tipo de unidade funcional (também usado na linha de comando).
+inline const char *functionalUnitName(FUType type) {
+    static const char *names[FU_TYPE_COUNT] = {"add", "mul", "div", "load", "store", "fpadd", "fpmul", "fpdiv"};
+    return names[type];
+}
+
+// Conjunto de unidades funcionais de um mesmo tipo.
+struct FunctionalUnitPool {
+    bool pipelined = true;      // Pipelined: aceita nova operação a cada 'issueInterval' ciclos.
+                                // Não pipelined: ocupada durante toda a latência da operação.
+    int issueInterval = 1;      // Ciclos entre duas operações iniciadas na mesma unidade pipelined.
+    vector<int> nextFreeCycle;  // Por unidade: primeiro ciclo em que ela aceita nova operação.
+    long long operations = 0;   // Operações iniciadas nas unidades deste tipo.
+    long long stallCycles = 0;  // Soma, por ciclo, das RSs prontas que não acharam unidade livre.
+};
+
+// Valor sentinela das tags Qj/Qk: o operando correspondente já está pronto em Vj/Vk.
+const int TAG_READY = -1;
+
+// Representa uma Estação de Reserva (RS).
+// As RSs contêm instruções que aguardam operandos ou a disponibilidade de UFs.
+struct ReservationStation {
+    bool busy = false;            // Esta RS está ocupada?
+    InstructionType op = INVALID; // Operação sendo processada ou aguardada.
+    Word Vj = 0, Vk = 0;          // Valores dos operandos fonte. Vj para src1, Vk para src2/base.
+    int Qj = TAG_READY;           // Tags (índices do ROB) que produzirão Vj e Vk.
+    int Qk = TAG_READY;           // Se TAG_READY, Vj/Vk estão prontos.
+    int destRobIndex = -1;        // Para qual entrada do ROB esta RS enviará o resultado.
+    int A = 0;                    // Campo para offset em instruções L.D/S.D.
+    int instructionIndex = -1;    // Índice da instrução original associada a esta RS.
+    // rename = prf: registradores físicos dos operandos, lidos na execução (no lugar de Vj/Vk).
+    int Pj = -1, Pk = -1;         // -1: o operando está em Vj/Vk.
+    int thread = 0;               // SMT: thread dona da instrução (as tags são do ROB dela). Fora do snapshot.
+
+    template <class Archive> void transfer(Archive &ar) {
+        ar(busy); ar(op); ar(Vj); ar(Vk); ar(Qj); ar(Qk); ar(destRobIndex); ar(A); ar(instructionIndex); ar(Pj); ar(Pk);
+    }
+};
+
+// Status de um registrador arquitetural, essencial para a renomeação.
+// Indica se o valor do registrador está pendente e qual entrada do ROB o produzirá.
+struct RegisterStatus {
+    bool busy = false;          // True se o registrador aguarda um resultado de uma entrada do ROB.
+    int robIndex = -1;          // Índice da entrada do ROB que fornecerá o valor.
+                                // -1 indica que o valor está no banco de registradores, não pendente.
+
+    template <class Archive> void transfer(Archive &ar) { ar(busy); ar(robIndex); }
+};
+
+// Estatísticas de uso da largura de um estágio superescalar (Issue, CDB ou Commit).
+struct StageWidthStats {
+    vector<long long> perCycle;  // perCycle[k]: ciclos em que o estágio processou k instruções.
+    long long fullCycles = 0;    // Ciclos em que toda a largura foi usada.
+    long long limitedCycles = 0; // Ciclos com a largura esgotada e ainda havia trabalho pronto para o estágio.
+    long long total = 0;         // Total de instruções processadas pelo estágio.
+
+    explicit StageWidthStats(int width = 1) : perCycle(width + 1, 0) {}
+
+    // Registra um ciclo em que o estágio processou 'used' instruções.
+    void record(int used, bool morePending) {
+        perCycle[used]++;
+        total += used;
+        if (used == static_cast<int>(perCycle.size()) - 1) {
+            fullCycles++;
+            if (morePending) limitedCycles++;
+        }
+    }
+
+    template <class Archive> void transfer(Archive &ar) { snapshotSized(ar, perCycle, "largura"); ar(fullCycles); ar(limitedCycles); ar(total); }
+};
+
+// Histograma de valores inteiros não negativos com baldes de largura 1.
+// Valores a partir de 'limit' caem no último balde. Cada amostra pode ter um peso
+// (ex: quantidade de ciclos em que o valor se manteve).
+struct Histogram {
+    vector<long long> buckets;
+    long long samples = 0;  // Soma dos pesos.
+    long long sum = 0;      // Soma de valor * peso (para a média).
+    int maxValue = 0;
+
+    explicit Histogram(int limit = 64) : buckets(limit + 1, 0) {}
+
+    void add(int value, long long weight = 1) {
+        int bucket = min(max(value, 0), static_cast<int>(buckets.size()) - 1);
+        buckets[bucket] += weight;
+        samples += weight;
+        sum += static_cast<long long>(value) * weight;
+        if (value > maxValue) maxValue = value;
+    }
+
+    double mean() const { return samples > 0 ? static_cast<double>(sum) / samples : 0.0; }
+
+    // Menor valor v tal que pelo menos 'fraction' das amostras são <= v (0 sem amostras).
+    int percentile(double fraction) const {
+        if (samples == 0) return 0;
+        long long needed = static_cast<long long>(fraction * samples + 0.5), seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            seen += buckets[i];
+            if (seen >= needed && seen > 0) return static_cast<int>(i);
+        }
+        return static_cast<int>(buckets.size()) - 1;
+    }
+
+    template <class Archive> void transfer(Archive &ar) { snapshotSized(ar, buckets, "histograma"); ar(samples); ar(sum); ar(maxValue); }
+};
+
+// Motivo pelo qual o Issue não conseguiu emitir a próxima instrução.
+enum IssueStallCause {
+    ISSUE_OK,             // Sem parada: a instrução pode ser emitida.
+    STALL_NO_INSTRUCTION, // Todas as instruções do programa já foram emitidas.
+    STALL_ROB_FULL,       // Nenhuma entrada livre no ROB.
+    STALL_RS_ADD_FULL,    // Nenhuma RS livre no grupo da instrução (findFreeRS falhou).
+    STALL_RS_MUL_FULL,
+    STALL_RS_LOAD_FULL,
+    STALL_RS_STORE_FULL,
+    STALL_RS_FPADD_FULL,
+    STALL_RS_FPMUL_FULL,
+    STALL_PRF_FULL,       // rename = prf: nenhum registrador físico livre para o destino.
+    ISSUE_STALL_CAUSE_COUNT
+};
+
+// Coletor de estatísticas do simulador. Tudo é contado por ciclo com custo O(1)
+// (ou O(largura)), então pode ficar ligado nas execuções em batch.
+struct SimulatorStats {
+    StageWidthStats issueWidth, cdbWidth, commitWidth; // Uso da largura de cada estágio.
+    long long issueStallCycles[ISSUE_STALL_CAUSE_COUNT] = {}; // Ciclos em que o Issue parou, por motivo.
+    Histogram cdbQueueDepth;              // Resultados aguardando o CDB no início do WriteResult.
+    Histogram robOccupancy;               // Entradas ocupadas do ROB ao fim de cada ciclo.
+    Histogram rsOccupancy[RS_GROUP_COUNT]; // RSs ocupadas de cada grupo ao fim de cada ciclo.
+    Histogram prfOccupancy;               // rename = prf: físicos alocados a instruções em voo, ao fim de cada ciclo.
+    Histogram operandWait;                // Por instrução: ciclos entre a emissão e ter todos os operandos.
+    Histogram qjWait, qkWait;             // Por operando que precisou esperar: ciclos até a tag em Qj/Qk chegar.
+    long long committedInstructions = 0;
+    // Fila de LOADs/STOREs.
+    long long forwardedLoads = 0;         // LOADs que receberam o valor de um STORE em voo.
+    long long speculativeLoads = 0;       // LOADs executados antes de STOREs mais antigos com endereço desconhecido.
+    long long memoryWaitCycles = 0;       // Soma, por ciclo, dos LOADs prontos retidos por um STORE mais antigo.
+    long long memoryReplays = 0;          // Violações de ordem de memória (LOAD e as seguintes reexecutados).
+    long long squashedInstructions = 0;   // Instruções descartadas pelas reexecuções.
+    // Desvios (contados no commit, então o caminho errado não entra).
+    long long branches = 0;               // Desvios condicionais cometidos.
+    long long takenBranches = 0;
+    long long mispredictions = 0;         // Desvios condicionais com a direção mal prevista.
+    long long jumps = 0;                  // Saltos incondicionais cometidos.
+    long long wrongPathInstructions = 0;  // Instruções descartadas por previsões erradas.
+    long long fastForwarded = 0;          // Instruções executadas no modo funcional antes do pipeline.
+
+    SimulatorStats(int issue, int cdbs, int commit, int robSize, int addRSCount, int mulRSCount, int loadRSCount, int storeRSCount,
+                   int fpAddRSCount, int fpMulRSCount)
+        : issueWidth(issue), cdbWidth(cdbs), commitWidth(commit), robOccupancy(robSize) {
+        rsOccupancy[RS_ADD] = Histogram(addRSCount);
+        rsOccupancy[RS_MUL] = Histogram(mulRSCount);
+        rsOccupancy[RS_LOAD] = Histogram(loadRSCount);
+        rsOccupancy[RS_STORE] = Histogram(storeRSCount);
+        rsOccupancy[RS_FPADD] = Histogram(fpAddRSCount);
+        rsOccupancy[RS_FPMUL] = Histogram(fpMulRSCount);
+    }
+
+    template <class Archive> void transfer(Archive &ar) {
+        ar(issueWidth); ar(cdbWidth); ar(commitWidth);
+        for (int c = 0; c < ISSUE_STALL_CAUSE_COUNT; ++c) ar(issueStallCycles[c]);
+        ar(cdbQueueDepth); ar(robOccupancy);
+        for (int g = 0; g < RS_GROUP_COUNT; ++g) ar(rsOccupancy[g]);
+        ar(prfOccupancy); ar(operandWait); ar(qjWait); ar(qkWait); ar(committedInstructions);
+        ar(forwardedLoads); ar(speculativeLoads); ar(memoryWaitCycles); ar(memoryReplays); ar(squashedInstructions);
+        ar(branches); ar(takenBranches); ar(mispredictions); ar(jumps); ar(wrongPathInstructions);
+        ar(fastForwarded);
+    }
+};
+
+// Ordenação de memória entre LOADs e STOREs em voo.
+enum MemoryOrderMode {
+    MEMORY_ORDER_NONE,         // Modelo original: o LOAD lê a memória no WriteResult, sem olhar os STOREs em voo.
+    MEMORY_ORDER_CONSERVATIVE, // O LOAD espera os endereços de todos os STOREs mais antigos.
+    MEMORY_ORDER_SPECULATIVE,  // O LOAD passa à frente de STOREs com endereço desconhecido; se errar, é reexecutado.
+    MEMORY_ORDER_MODE_COUNT
+};
+
+inline const char *memoryOrderName(MemoryOrderMode mode) {
+    static const char *names[MEMORY_ORDER_MODE_COUNT] = {"none", "conservative", "speculative"};
+    return names[mode];
+}
+
+// Esquema de renomeação dos registradores (rename).
+enum RenameMode {
+    RENAME_ROB, // Modelo original: o resultado fica no ROB e é copiado para as RSs no broadcast do CDB.
+    RENAME_PRF, // Banco de registradores físicos com lista livre e tabela de mapeamento (estilo MIPS R10000).
+    RENAME_MODE_COUNT
+};
+
+inline const char *renameModeName(RenameMode mode) {
+    static const char *names[RENAME_MODE_COUNT] = {"rob", "prf"};
+    return names[mode];
+}
+
+// Valor das palavras de memória nunca escritas (memory.fill).
+enum MemoryFill {
+    MEMORY_FILL_IDENTITY, // memory[i] = i, como no modelo original (facilita a verificação).
+    MEMORY_FILL_ZERO,
+    MEMORY_FILL_COUNT
+};
+
+inline const char *memoryFillName(MemoryFill fill) {
+    static const char *names[MEMORY_FILL_COUNT] = {"identity", "zero"};
+    return names[fill];
+}
+
+// Preditor de direção dos desvios condicionais (branch.predictor).
+enum BranchPredictorKind {
+    BRANCH_PREDICTOR_STATIC,  // Estático: desvio para trás tomado, para frente não tomado.
+    BRANCH_PREDICTOR_BIMODAL, // Contadores de 2 bits indexados pelo endereço do desvio.
+    BRANCH_PREDICTOR_GSHARE,  // Contadores de 2 bits indexados pelo endereço XOR o histórico global.
+    BRANCH_PREDICTOR_KIND_COUNT
+};
+
+inline const char *branchPredictorName(BranchPredictorKind kind) {
+    static const char *names[BRANCH_PREDICTOR_KIND_COUNT] = {"static", "bimodal", "gshare"};
+    return names[kind];
+}
+
+// Com várias threads (SMT), qual thread começa a emitir em cada ciclo (smt.policy).
+enum SmtPolicy {
+    SMT_ROUND_ROBIN, // A thread inicial avança uma posição a cada ciclo.
+    SMT_ICOUNT,      // Primeiro a thread com menos RSs ocupadas (Tullsen et al., 1996).
+    SMT_POLICY_COUNT
+};
+
+inline const char *smtPolicyName(SmtPolicy policy) {
+    static const char *names[SMT_POLICY_COUNT] = {"round_robin", "icount"};
+    return names[policy];
+}
+
+// --- Descrição da máquina ---
+// Todos os parâmetros do processador simulado, com os valores do modelo original como padrão.
+// Pode ser lida de um arquivo "chave = valor" (--config) e alterada com --set CHAVE=VALOR.
+struct MachineConfig {
+    int addRS = 3, mulRS = 2, loadRS = 3, storeRS = 3; // Estações de reserva de cada grupo.
+    int fpAddRS = 3, fpMulRS = 2;                      // As de ponto flutuante (ADD.D/SUB.D/CVT e MUL.D/DIV.D).
+    int robSize = 16;                                  // Entradas do ROB.
+    int issueWidth = 1, cdbCount = 1, commitWidth = 1; // Larguras superescalares.
+    int registerCount = 32;                            // Registradores F (F0..F{registerCount-1}).
+    int intRegisterCount = 0;                          // Registradores inteiros (R0..R{intRegisterCount-1}); 0: só os F, inteiros.
+    int memorySize = 1024;                             // Palavras de memória (só as páginas tocadas ocupam espaço).
+    MemoryFill memoryFill = MEMORY_FILL_IDENTITY;      // Valor inicial das palavras (memory.fill).
+    int addLatency = 2, mulLatency = 10, divLatency = 40, loadLatency = 2, storeLatency = 2; // Em ciclos.
+    int fpAddLatency = 4, fpMulLatency = 7, fpDivLatency = 25; // Operações de ponto flutuante (.D e conversões).
+    MemoryOrderMode memoryOrder = MEMORY_ORDER_CONSERVATIVE; // Ordenação entre LOADs e STOREs (memory_order).
+    RenameMode renameMode = RENAME_ROB;                // Esquema de renomeação (rename).
+    int physicalRegisters = 0;                         // Registradores físicos com rename = prf (0: registers + rob).
+    // Hierarquia de caches entre os LOADs/STOREs e a memória. Tamanhos e linhas em palavras;
+    // l1Size = 0 desliga os caches (latência fixa latency.load/latency.store); l2Size = 0, só L1.
+    int l1Size = 0, l1Ways = 2, l1Line = 4, l1Latency = 1, l1Mshrs = 4;
+    int l2Size = 0, l2Ways = 4, l2Line = 8, l2Latency = 8, l2Mshrs = 8;
+    int memoryLatency = 50;                            // Ciclos de um acesso à memória após faltar em todos os níveis.
+    BranchPredictorKind branchPredictor = BRANCH_PREDICTOR_BIMODAL; // branch.predictor.
+    int branchTableSize = 1024;                        // Contadores de 2 bits (potência de 2).
+    int branchHistoryBits = 10;                        // Bits do histórico global (gshare).
+    // Threads de hardware (SMT): cada uma com o seu programa, registradores, memória e uma
+    // partição de rob / smt.threads entradas do ROB; RSs, unidades funcionais, CDB e caches são compartilhados.
+    int threadCount = 1;                               // smt.threads.
+    SmtPolicy smtPolicy = SMT_ROUND_ROBIN;             // Ordem das threads no Issue (smt.policy).
+    // Unidades funcionais configuradas, aplicadas sobre o padrão (uma unidade pipelined por RS).
+    struct FunctionalUnitConfig { FUType type; int count; bool pipelined; int issueInterval; };
+    vector<FunctionalUnitConfig> functionalUnits;
+};
+
+// Parâmetro inteiro da descrição da máquina: nome no arquivo (e em --set/--sweep) e limites.
+struct MachineConfigKey {
+    const char *name;
+    int MachineConfig::*field;
+    int minValue, maxValue;
+};
+const MachineConfigKey machineConfigKeys[] = {
+    {"rs.add", &MachineConfig::addRS, 1, 1 << 20},
+    {"rs.mul", &MachineConfig::mulRS, 1, 1 << 20},
+    {"rs.load", &MachineConfig::loadRS, 1, 1 << 20},
+    {"rs.store", &MachineConfig::storeRS, 1, 1 << 20},
+    {"rs.fpadd", &MachineConfig::fpAddRS, 1, 1 << 20},
+    {"rs.fpmul", &MachineConfig::fpMulRS, 1, 1 << 20},
+    {"rob", &MachineConfig::robSize, 1, 1 << 24},
+    {"issue_width", &MachineConfig::issueWidth, 1, 1 << 10},
+    {"cdbs", &MachineConfig::cdbCount, 1, 1 << 10},
+    {"commit_width", &MachineConfig::commitWidth, 1, 1 << 10},
+    {"registers", &MachineConfig::registerCount, 1, INT_REGISTER_BIT - 1},
+    {"registers.int", &MachineConfig::intRegisterCount, 0, INT_REGISTER_BIT - 1},
+    {"memory", &MachineConfig::memorySize, 1, numeric_limits<int>::max()},
+    {"latency.add", &MachineConfig::addLatency, 1, 1 << 16},
+    {"latency.mul", &MachineConfig::mulLatency, 1, 1 << 16},
+    {"latency.div", &MachineConfig::divLatency, 1, 1 << 16},
+    {"latency.load", &MachineConfig::loadLatency, 1, 1 << 16},
+    {"latency.store", &MachineConfig::storeLatency, 1, 1 << 16},
+    {"latency.fpadd", &MachineConfig::fpAddLatency, 1, 1 << 16},
+    {"latency.fpmul", &MachineConfig::fpMulLatency, 1, 1 << 16},
+    {"latency.fpdiv", &MachineConfig::fpDivLatency, 1, 1 << 16},
+    {"l1.size", &MachineConfig::l1Size, 0, 1 << 24},
+    {"l1.ways", &MachineConfig::l1Ways, 1, 1 << 10},
+    {"l1.line", &MachineConfig::l1Line, 1, 1 << 10},
+    {"l1.latency", &MachineConfig::l1Latency, 1, 1 << 12},
+    {"l1.mshrs", &MachineConfig::l1Mshrs, 1, 1 << 10},
+    {"l2.size", &MachineConfig::l2Size, 0, 1 << 26},
+    {"l2.ways", &MachineConfig::l2Ways, 1, 1 << 10},
+    {"l2.line", &MachineConfig::l2Line, 1, 1 << 10},
+    {"l2.latency", &MachineConfig::l2Latency, 1, 1 << 12},
+    {"l2.mshrs", &MachineConfig::l2Mshrs, 1, 1 << 10},
+    {"memory.latency", &MachineConfig::memoryLatency, 1, 1 << 14},
+    {"branch.table", &MachineConfig::branchTableSize, 1, 1 << 24},
+    {"branch.history", &MachineConfig::branchHistoryBits, 0, 24},
+    {"prf.size", &MachineConfig::physicalRegisters, 0, 1 << 24},
+    {"smt.threads", &MachineConfig::threadCount, 1, 16},
+};
+const int MACHINE_CONFIG_KEY_COUNT = sizeof(machineConfigKeys) / sizeof(machineConfigKeys[0]);
+
+// Procura um parâmetro inteiro pelo nome. Retorna nullptr se não existir.
+inline const MachineConfigKey *findMachineConfigKey(const string &name) {
+    for (int k = 0; k < MACHINE_CONFIG_KEY_COUNT; ++k) {
+        if (name == machineConfigKeys[k].name) return &machineConfigKeys[k];
+    }
+    return nullptr;
+}
+
+// Lê um inteiro ocupando a string inteira (sem sobras como "12abc").
+inline bool parseWholeInt(const string &text, int &value) {
+    if (text.empty()) return false;
+    char *end = nullptr;
+    long parsed = strtol(text.c_str(), &end, 10);
+    if (*end != '\0' || parsed < numeric_limits<int>::min() || parsed > numeric_limits<int>::max()) return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+// Valor de uma palavra: um inteiro de 64 bits ou, se não for inteiro, um double (ex: 2.5, 1e-3).
+inline bool parseWordValue(const string &text, Word &value) {
+    if (text.empty()) return false;
+    char *end = nullptr;
+    errno = 0;
+    long long parsed = strtoll(text.c_str(), &end, 10);
+    if (*end == '\0' && errno == 0) { value = parsed; return true; }
+    double number = strtod(text.c_str(), &end);
+    if (*end != '\0') return false;
+    value = doubleToWord(number);
+    return true;
+}
+
+// Remove espaços no início e no fim.
+inline string trimSpaces(const string &text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == string::npos) return "";
+    return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+// Lê uma especificação de unidade funcional no formato TIPO=N[,pipe|nopipe][,INTERVALO].
+inline bool parseFunctionalUnitConfig(const string &spec, MachineConfig::FunctionalUnitConfig &option) {
+    size_t eq = spec.find('=');
+    if (eq == string::npos) return false;
+    string typeName = spec.substr(0, eq);
+    int type = 0;
+    while (type < FU_TYPE_COUNT && typeName != functionalUnitName(static_cast<FUType>(type))) type++;
+    if (type == FU_TYPE_COUNT) return false;
+    option.type = static_cast<FUType>(type);
+    option.pipelined = true;
+    option.issueInterval = 1;
+
+    stringstream fields(spec.substr(eq + 1));
+    string field;
+    if (!getline(fields, field, ',')) return false;
+    option.count = atoi(field.c_str());
+    if (option.count <= 0) return false;
+    while (getline(fields, field, ',')) {
+        if (field == "pipe") option.pipelined = true;
+        else if (field == "nopipe") option.pipelined = false;
+        else if ((option.issueInterval = atoi(field.c_str())) <= 0) return false;
+    }
+    return true;
+}
+
+// Aplica "chave = valor" à descrição da máquina. Além dos parâmetros inteiros, aceita
+// "fu.TIPO = N[,pipe|nopipe][,INTERVALO]" (como --fu), "memory.fill = identity|zero",
+// "memory_order = none|conservative|speculative", "rename = rob|prf", "branch.predictor = static|bimodal|gshare"
+// e "smt.policy = round_robin|icount".
+// Em caso de erro, 'error' diz o motivo.
+inline bool applyMachineSetting(MachineConfig &config, const string &key, const string &value, string &error) {
+    if (key == "memory.fill") {
+        int fill = 0;
+        while (fill < MEMORY_FILL_COUNT && value != memoryFillName(static_cast<MemoryFill>(fill))) fill++;
+        if (fill == MEMORY_FILL_COUNT) {
+            error = "valor invalido para memory.fill: " + value + " (esperado identity ou zero)";
+            return false;
+        }
+        config.memoryFill = static_cast<MemoryFill>(fill);
+        return true;
+    }
+    if (key == "memory_order") {
+        int mode = 0;
+        while (mode < MEMORY_ORDER_MODE_COUNT && value != memoryOrderName(static_cast<MemoryOrderMode>(mode))) mode++;
+        if (mode == MEMORY_ORDER_MODE_COUNT) {
+            error = "valor invalido para memory_order: " + value + " (esperado none, conservative ou speculative)";
+            return false;
+        }
+        config.memoryOrder = static_cast<MemoryOrderMode>(mode);
+        return true;
+    }
+    if (key == "rename") {
+        int mode = 0;
+        while (mode < RENAME_MODE_COUNT && value != renameModeName(static_cast<RenameMode>(mode))) mode++;
+        if (mode == RENAME_MODE_COUNT) {
+            error = "valor invalido para rename: " + value + " (esperado rob ou prf)";
+            return false;
+        }
+        config.renameMode = static_cast<RenameMode>(mode);
+        return true;
+    }
+    if (key == "branch.predictor") {
+        int kind = 0;
+        while (kind < BRANCH_PREDICTOR_KIND_COUNT && value != branchPredictorName(static_cast<BranchPredictorKind>(kind))) kind++;
+        if (kind == BRANCH_PREDICTOR_KIND_COUNT) {
+            error = "valor invalido para branch.predictor: " + value + " (esperado static, bimodal ou gshare)";
+            return false;
+        }
+        config.branchPredictor = static_cast<BranchPredictorKind>(kind);
+        return true;
+    }
+    if (key == "smt.policy") {
+        int policy = 0;
+        while (policy < SMT_POLICY_COUNT && value != smtPolicyName(static_cast<SmtPolicy>(policy))) policy++;
+        if (policy == SMT_POLICY_COUNT) {
+            error = "valor invalido para smt.policy: " + value + " (esperado round_robin ou icount)";
+            return false;
+        }
+        config.smtPolicy = static_cast<SmtPolicy>(policy);
+        return true;
+    }
+    if (key.compare(0, 3, "fu.") == 0) {
+        MachineConfig::FunctionalUnitConfig unit;
+        if (!parseFunctionalUnitConfig(key.substr(3) + "=" + value, unit)) {
+            error = "unidade funcional invalida: " + key + " = " + value;
+            return false;
+        }
+        config.functionalUnits.push_back(unit);
+        return true;
+    }
+    const MachineConfigKey *entry = findMachineConfigKey(key);
+    if (!entry) { error = "chave desconhecida: " + key; return false; }
+    int number = 0;
+    if (!parseWholeInt(value, number) || number < entry->minValue || number > entry->maxValue) {
+        error = "valor invalido para " + key + ": " + value + " (esperado " + to_string(entry->minValue) +
+                ".." + to_string(entry->maxValue) + ")";
+        return false;
+    }
+    config.*(entry->field) = number;
+    return true;
+}
+
+// Verifica se todos os parâmetros inteiros estão dentro dos limites.
+inline bool validateMachineConfig(const MachineConfig &config, string &error) {
+    for (int k = 0; k < MACHINE_CONFIG_KEY_COUNT; ++k) {
+        const MachineConfigKey &entry = machineConfigKeys[k];
+        int value = config.*(entry.field);
+        if (value < entry.minValue || value > entry.maxValue) {
+            error = string("valor invalido para ") + entry.name + ": " + to_string(value);
+            return false;
+        }
+    }
+    if (config.l1Size % (config.l1Ways * config.l1Line) != 0 || config.l2Size % (config.l2Ways * config.l2Line) != 0) {
+        error = "o tamanho de cada cache deve ser multiplo de vias * linha";
+        return false;
+    }
+    if (config.l1Size == 0 && config.l2Size > 0) {
+        error = "l2.size exige um L1 (l1.size > 0)";
+        return false;
+    }
+    if ((config.branchTableSize & (config.branchTableSize - 1)) != 0) {
+        error = "branch.table deve ser potencia de 2";
+        return false;
+    }
+    if (config.physicalRegisters != 0 && config.physicalRegisters <= config.registerCount + config.intRegisterCount) {
+        error = "prf.size deve ser maior que registers + registers.int (ou 0)";
+        return false;
+    }
+    if (config.robSize % config.threadCount != 0) {
+        error = "rob deve ser multiplo de smt.threads (cada thread tem rob / smt.threads entradas)";
+        return false;
+    }
+    if (config.threadCount > 1 && config.renameMode != RENAME_ROB) {
+        error = "smt.threads > 1 exige rename = rob";
+        return false;
+    }
+    if (config.memorySize > numeric_limits<int>::max() / config.threadCount) {
+        error = "memory * smt.threads excede o maior endereco dos caches";
+        return false;
+    }
+    return true;
+}
+
+// Maior latência possível de um acesso à hierarquia de caches (falta em todos os níveis).
+// 0 sem caches. A roda de execução precisa comportar essa latência.
+inline int worstMemoryAccessLatency(const MachineConfig &config) {
+    if (config.l1Size == 0) return 0;
+    return config.l1Latency + (config.l2Size > 0 ? config.l2Latency : 0) + config.memoryLatency;
+}
+
+// Maior latência das operações de ponto flutuante (que também precisa caber na roda).
+inline int worstFloatingPointLatency(const MachineConfig &config) {
+    return max(max(config.fpAddLatency, config.fpMulLatency), config.fpDivLatency);
+}
+
+// Lê uma descrição da máquina: uma linha "chave = valor" por parâmetro, com comentários
+// iniciados por '#'. Parâmetros ausentes mantêm o valor atual. 'name' identifica a origem nos erros.
+inline bool readMachineConfig(istream &input, const string &name, MachineConfig &config, ostream &err) {
+    string line;
+    for (int lineNumber = 1; getline(input, line); ++lineNumber) {
+        line = trimSpaces(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+        size_t eq = line.find('=');
+        string error = "esperado chave = valor";
+        if (eq == string::npos || !applyMachineSetting(config, trimSpaces(line.substr(0, eq)), trimSpaces(line.substr(eq + 1)), error)) {
+            err << name << ":" << lineNumber << ": " << error << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Lê um arquivo de descrição da máquina (formato de readMachineConfig).
+inline bool loadMachineConfig(const string &path, MachineConfig &config, ostream &err) {
+    ifstream file(path.c_str());
+    if (!file.is_open()) {
+        err << "Erro ao abrir arquivo de configuracao: " << path << endl;
+        return false;
+    }
+    return readMachineConfig(file, path, config, err);
+}
+
+// Grava a descrição da máquina no formato do arquivo de configuração.
+inline void writeMachineConfig(ostream &out, const MachineConfig &config) {
+    for (int k = 0; k < MACHINE_CONFIG_KEY_COUNT; ++k) {
+        out << machineConfigKeys[k].name << " = " << config.*(machineConfigKeys[k].field) << "\n";
+    }
+    out << "memory.fill = " << memoryFillName(config.memoryFill) << "\n";
+    out << "memory_order = " << memoryOrderName(config.memoryOrder) << "\n";
+    out << "rename = " << renameModeName(config.renameMode) << "\n";
+    out << "branch.predictor = " << branchPredictorName(config.branchPredictor) << "\n";
+    out << "smt.policy = " << smtPolicyName(config.smtPolicy) << "\n";
+    for (size_t i = 0; i < config.functionalUnits.size(); ++i) {
+        const MachineConfig::FunctionalUnitConfig &unit = config.functionalUnits[i];
+        out << "fu." << functionalUnitName(unit.type) << " = " << unit.count << (unit.pipelined ? ",pipe," : ",nopipe,")
+            << unit.issueInterval << "\n";
+    }
+}
+
+// --- Memória simulada ---
+// Memória esparsa e paginada: só as páginas escritas são alocadas, então a memória usada
+// acompanha o conjunto de trabalho e não o tamanho configurado. Uma leitura de uma palavra
+// nunca escrita devolve o valor inicial (memory.fill) sem alocar a página.
+class SparseMemory {
+public:
+    static const int PAGE_BITS = 10;
+    static const int PAGE_WORDS = 1 << PAGE_BITS;
+
+    SparseMemory(int words, MemoryFill initialFill) : wordCount(words), fill(initialFill) {}
+    // A cópia tem as suas próprias páginas: o atalho da última página não vem junto.
+    SparseMemory(const SparseMemory &other) : wordCount(other.wordCount), fill(other.fill), pages(other.pages) {}
+    SparseMemory &operator=(const SparseMemory &other) {
+        wordCount = other.wordCount;
+        fill = other.fill;
+        pages = other.pages;
+        lastPageNumber = -1;
+        lastPage = nullptr;
+        return *this;
+    }
+    // Troca sem copiar as páginas (os nós do mapa não mudam de lugar, então o atalho continua válido).
+    void swap(SparseMemory &other) {
+        std::swap(wordCount, other.wordCount);
+        std::swap(fill, other.fill);
+        pages.swap(other.pages);
+        std::swap(lastPageNumber, other.lastPageNumber);
+        std::swap(lastPage, other.lastPage);
+    }
+
+    int size() const { return wordCount; }
+    bool contains(int address) const { return address >= 0 && address < wordCount; }
+
+    // Valor de uma palavra do intervalo [0, size()).
+    Word read(int address) const {
+        const Word *page = findPage(address >> PAGE_BITS);
+        return page ? page[address & (PAGE_WORDS - 1)] : initialValue(address);
+    }
+
+    // Escreve uma palavra do intervalo [0, size()), alocando a página se ainda não existir.
+    void write(int address, Word value) {
+        int pageNumber = address >> PAGE_BITS;
+        Word *page = findPage(pageNumber);
+        if (!page) {
+            vector<Word> &data = pages[pageNumber];
+            data.resize(PAGE_WORDS);
+            for (int i = 0; i < PAGE_WORDS; ++i) data[i] = initialValue((pageNumber << PAGE_BITS) + i);
+            page = data.data();
+            lastPageNumber = pageNumber; // O vetor da página não muda de lugar (nós do mapa são estáveis).
+            lastPage = page;
+        }
+        page[address & (PAGE_WORDS - 1)] = value;
+    }
+
+    size_t pageCount() const { return pages.size(); }
+
+    // Páginas alocadas, em ordem de número (o snapshot não depende da ordem do mapa).
+    template <class Archive> void transfer(Archive &ar) {
+        ar.expect(wordCount, "memory");
+        ar.expect(fill, "memory.fill");
+        vector<int> pageNumbers;
+        for (auto it = pages.begin(); it != pages.end(); ++it) pageNumbers.push_back(it->first);
+        sort(pageNumbers.begin(), pageNumbers.end());
+        snapshotItems(ar, pageNumbers);
+        if (ar.loading()) {
+            pages.clear();
+            lastPageNumber = -1;
+            lastPage = nullptr;
+        }
+        for (size_t i = 0; i < pageNumbers.size() && ar.ok(); ++i) {
+            if (pageNumbers[i] < 0 || pageNumbers[i] > (wordCount - 1) >> PAGE_BITS) { ar.fail("pagina de memoria fora do intervalo"); return; }
+            vector<Word> &data = pages[pageNumbers[i]];
+            if (ar.loading()) data.resize(PAGE_WORDS);
+            snapshotSized(ar, data, "pagina de memoria");
+        }
+    }
+
+private:
+    int wordCount;
+    MemoryFill fill;
+    unordered_map<int, vector<Word>> pages; // Número da página -> palavras.
+    // Última página acessada: acessos seguidos à mesma página evitam a busca no mapa.
+    mutable int lastPageNumber = -1;
+    mutable Word *lastPage = nullptr;
+
+    Word initialValue(int address) const { return fill == MEMORY_FILL_IDENTITY ? address : 0; }
+
+    Word *findPage(int pageNumber) const {
+        if (pageNumber == lastPageNumber) return lastPage;
+        auto it = pages.find(pageNumber);
+        if (it == pages.end()) return nullptr;
+        lastPageNumber = pageNumber;
+        lastPage = const_cast<Word *>(it->second.data());
+        return lastPage;
+    }
+};
+
+inline void swap(SparseMemory &a, SparseMemory &b) { a.swap(b); }
+
+// Imagem inicial da memória (--memory-image): palavras a escrever antes da simulação.
+// Lida uma vez e aplicada a cada simulador (ex: todas as configurações de uma varredura).
+struct MemoryImage {
+    struct Entry { int address; Word value; int line; };
+    string path;
+    vector<Entry> words;
+};
+
+// Lê uma imagem de memória: linhas "ENDERECO VALOR [VALOR...]", com os valores em endereços
+// consecutivos a partir de ENDERECO; '#' inicia um comentário. Um valor com ponto decimal ou
+// expoente (ex: 2.5) é gravado como double (para L.D em registradores F).
+inline bool loadMemoryImage(const string &path, MemoryImage &image, ostream &err) {
+    ifstream file(path.c_str());
+    if (!file.is_open()) {
+        err << "Erro ao abrir imagem de memoria: " << path << endl;
+        return false;
+    }
+    image.path = path;
+    image.words.clear();
+    string line;
+    for (int lineNumber = 1; getline(file, line); ++lineNumber) {
+        istringstream fields(line.substr(0, line.find('#')));
+        string field;
+        if (!(fields >> field)) continue;
+        int address = 0, count = 0;
+        Word value = 0;
+        if (!parseWholeInt(field, address) || address < 0) {
+            err << path << ":" << lineNumber << ": endereco invalido: " << field << endl;
+            return false;
+        }
+        for (; fields >> field; ++count) {
+            if (!parseWordValue(field, value)) {
+                err << path << ":" << lineNumber << ": valor invalido: " << field << endl;
+                return false;
+            }
+            if (count > numeric_limits<int>::max() - address) { // O endereço da palavra não cabe em int.
+                err << path << ":" << lineNumber << ": endereco fora da faixa: " << address << " + " << count << endl;
+                return false;
+            }
+            MemoryImage::Entry word = {address + count, value, lineNumber};
+            image.words.push_back(word);
+        }
+        if (count == 0) {
+            err << path << ":" << lineNumber << ": esperado ENDERECO VALOR [VALOR...]" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// --- Hierarquia de caches ---
+// Modelo só de tempo: os dados continuam em 'memory'; cada nível guarda as tags das linhas
+// (associativo por conjunto, substituição LRU) para decidir se o acesso acerta ou falta.
+// Uma falta ocupa um MSHR do nível até a linha chegar. Um acesso a uma linha que ainda está
+// chegando espera o restante da falta (mesclado ao MSHR). Sem MSHR livre, o acesso não pode
+// começar e tenta de novo no próximo ciclo. STOREs alocam a linha na execução (o dado vai
+// para a memória no commit, sem custo de write-back).
+struct CacheLevelStats {
+    long long accesses = 0;    // Acessos que chegaram ao nível.
+    long long hits = 0;        // Linha presente e já disponível.
+    long long misses = 0;      // Linha ausente: alocou um MSHR e buscou no nível seguinte.
+    long long merged = 0;      // Linha presente, mas ainda chegando (falta em andamento).
+    long long mshrStalls = 0;  // Soma, por ciclo, dos acessos prontos que não acharam MSHR livre neste nível.
+
+    template <class Archive> void transfer(Archive &ar) { ar(accesses); ar(hits); ar(misses); ar(merged); ar(mshrStalls); }
+};
+
+class CacheLevel {
+private:
+    struct Line {
+        bool valid = false;
+        int lineAddress = 0;   // Endereço / tamanho da linha.
+        long long lastUse = 0; // Para a substituição LRU.
+        int readyCycle = 0;    // Ciclo em que a linha chega (falta em andamento se > ciclo atual).
+
+        template <class Archive> void transfer(Archive &ar) { ar(valid); ar(lineAddress); ar(lastUse); ar(readyCycle); }
+    };
+    vector<Line> lines;        // sets * ways linhas; o conjunto 's' ocupa [s * ways, (s + 1) * ways).
+    vector<int> mshrBusyUntil; // Por MSHR: ciclo em que a falta atendida termina.
+    long long useCounter = 0;
+
+public:
+    const char *name;
+    int size, ways, lineWords, sets, latency;
+    CacheLevelStats stats;
+
+    CacheLevel(const char *levelName, int sizeWords, int wayCount, int lineSize, int hitLatency, int mshrCount) :
+        lines(sizeWords / lineSize), mshrBusyUntil(mshrCount, 0), name(levelName), size(sizeWords), ways(wayCount),
+        lineWords(lineSize), sets(sizeWords / (lineSize * wayCount)), latency(hitLatency) {}
+
+    int mshrCount() const { return static_cast<int>(mshrBusyUntil.size()); }
+
+    // Tags, LRU, MSHRs e contadores (snapshot). A geometria vem da máquina e é só conferida.
+    template <class Archive> void transfer(Archive &ar) {
+        ar.expect(ways, "vias do cache");
+        ar.expect(lineWords, "linha do cache");
+        snapshotSized(ar, lines, "linhas do cache");
+        snapshotSized(ar, mshrBusyUntil, "MSHRs do cache");
+        ar(useCounter);
+        ar(stats);
+    }
+
+    // Linha que contém 'address', ou nullptr se ela não está no nível.
+    Line *find(int address) {
+        int lineAddress = address / lineWords;
+        Line *set = &lines[static_cast<size_t>(lineAddress % sets) * ways];
+        for (int w = 0; w < ways; ++w) if (set[w].valid && set[w].lineAddress == lineAddress) return &set[w];
+        return nullptr;
+    }
+    const Line *find(int address) const { return const_cast<CacheLevel *>(this)->find(address); }
+
+    bool hasFreeMshr(int now) const {
+        for (size_t m = 0; m < mshrBusyUntil.size(); ++m) if (mshrBusyUntil[m] <= now) return true;
+        return false;
+    }
+
+    // Primeiro ciclo (> now) em que um MSHR ocupado fica livre; numeric_limits<int>::max() se nenhum está ocupado.
+    int nextMshrFree(int now) const {
+        int next = numeric_limits<int>::max();
+        for (size_t m = 0; m < mshrBusyUntil.size(); ++m) if (mshrBusyUntil[m] > now) next = min(next, mshrBusyUntil[m]);
+        return next;
+    }
+
+    void touch(Line &line) { line.lastUse = ++useCounter; }
+
+    // Aloca a linha de 'address' (vítima: linha inválida ou a menos usada do conjunto) e um
+    // MSHR, os dois até 'readyCycle'. Só deve ser chamada se hasFreeMshr(now).
+    void fill(int address, int now, int readyCycle) {
+        int lineAddress = address / lineWords;
+        Line *set = &lines[static_cast<size_t>(lineAddress % sets) * ways];
+        Line *victim = &set[0];
+        for (int w = 0; w < ways && victim->valid; ++w) if (!set[w].valid || set[w].lastUse < victim->lastUse) victim = &set[w];
+        victim->valid = true;
+        victim->lineAddress = lineAddress;
+        victim->readyCycle = readyCycle;
+        touch(*victim);
+        for (size_t m = 0; m < mshrBusyUntil.size(); ++m) {
+            if (mshrBusyUntil[m] <= now) { mshrBusyUntil[m] = readyCycle; break; }
+        }
+    }
+};
+
+// Níveis de cache (L1 e, opcionalmente, L2) na frente da memória principal.
+class CacheHierarchy {
+private:
+    vector<CacheLevel> levels;
+    int memoryLatency = 0;
+
+    // Acessa o nível 'index' (ou a memória, depois do último) e retorna a latência do acesso.
+    int accessLevel(size_t index, int address, int now) {
+        if (index == levels.size()) return memoryLatency;
+        CacheLevel &level = levels[index];
+        level.stats.accesses++;
+        if (auto *line = level.find(address)) {
+            level.touch(*line);
+            if (line->readyCycle <= now) { level.stats.hits++; return level.latency; }
+            level.stats.merged++;
+            return max(level.latency, line->readyCycle - now);
+        }
+        level.stats.misses++;
+        int total = level.latency + accessLevel(index + 1, address, now);
+        level.fill(address, now, now + total);
+        return total;
+    }
+
+public:
+    explicit CacheHierarchy(const MachineConfig &config) {
+        if (config.l1Size > 0) levels.push_back(CacheLevel("L1", config.l1Size, config.l1Ways, config.l1Line, config.l1Latency, config.l1Mshrs));
+        if (config.l2Size > 0) levels.push_back(CacheLevel("L2", config.l2Size, config.l2Ways, config.l2Line, config.l2Latency, config.l2Mshrs));
+        memoryLatency = config.memoryLatency;
+    }
+
+    bool enabled() const { return !levels.empty(); }
+    const vector<CacheLevel> &getLevels() const { return levels; }
+
+    template <class Archive> void transfer(Archive &ar) {
+        ar.expect(static_cast<int>(levels.size()), "niveis de cache");
+        for (size_t i = 0; i < levels.size() && ar.ok(); ++i) levels[i].transfer(ar);
+    }
+    int hitLatency() const { return levels.empty() ? 0 : levels[0].latency; }
+
+    // Nível que impede o acesso agora por falta de MSHR livre, ou -1 se o acesso pode começar.
+    // Um nível só precisa de MSHR se o acesso faltar nele.
+    int blockingLevel(int address, int now) const {
+        for (size_t i = 0; i < levels.size(); ++i) {
+            if (levels[i].find(address)) return -1;
+            if (!levels[i].hasFreeMshr(now)) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    // Faz o acesso (que deve poder começar: blockingLevel() == -1) e retorna a sua latência.
+    int access(int address, int now) { return accessLevel(0, address, now); }
+
+    // Aquecimento (modo funcional): traz a linha como um acesso, mas sem tempo, MSHRs nem estatísticas.
+    void warm(int address) {
+        for (size_t i = 0; i < levels.size(); ++i) {
+            if (auto *line = levels[i].find(address)) { levels[i].touch(*line); return; }
+            levels[i].fill(address, 0, 0);
+        }
+    }
+
+    void recordMshrStall(int level, long long cycles) { levels[level].stats.mshrStalls += cycles; }
+
+    // Próximo ciclo em que algum MSHR fica livre (para o escalonamento orientado a eventos).
+    int nextMshrFree(int now) const {
+        int next = numeric_limits<int>::max();
+        for (size_t i = 0; i < levels.size(); ++i) next = min(next, levels[i].nextMshrFree(now));
+        return next;
+    }
+};
+
+// --- Previsão de desvios ---
+// Prevê a direção de BEQ/BNE na busca. A tabela de contadores só é atualizada no commit,
+// então o caminho errado não a altera. O histórico global (gshare) é atualizado na busca,
+// com a direção prevista; cada desvio guarda o histórico que usou, e uma previsão errada
+// refaz o histórico a partir dele com a direção correta.
+class BranchPredictor {
+private:
+    BranchPredictorKind kind;
+    vector<uint8_t> counters;   // Contadores de 2 bits: 0-1 não tomado, 2-3 tomado.
+    unsigned tableMask;
+    unsigned historyMask;
+    unsigned history = 0;       // Histórico global especulativo: bit 0 é o desvio mais recente.
+
+    unsigned indexOf(int pc, unsigned pathHistory) const {
+        unsigned index = static_cast<unsigned>(pc);
+        if (kind == BRANCH_PREDICTOR_GSHARE) index ^= pathHistory;
+        return index & tableMask;
+    }
+
+public:
+    explicit BranchPredictor(const MachineConfig &config) :
+        kind(config.branchPredictor),
+        counters(kind == BRANCH_PREDICTOR_STATIC ? 0 : config.branchTableSize, 1), // Começam fracamente não tomados.
+        tableMask(static_cast<unsigned>(config.branchTableSize) - 1),
+        historyMask(static_cast<unsigned>((1u << config.branchHistoryBits) - 1)) {}
+
+    BranchPredictorKind getKind() const { return kind; }
+    unsigned getHistory() const { return history; }
+    void setHistory(unsigned value) { history = value & historyMask; } // Com SMT, cada thread tem o seu histórico.
+
+    // Direção prevista do desvio em 'pc' para 'target'.
+    bool predict(int pc, int target) const {
+        if (kind == BRANCH_PREDICTOR_STATIC) return target <= pc;
+        return counters[indexOf(pc, history)] >= 2;
+    }
+
+    // Avança o histórico com a direção prevista (na busca).
+    void speculate(bool taken) { history = ((history << 1) | (taken ? 1u : 0u)) & historyMask; }
+
+    // Previsão errada: o histórico volta ao de antes do desvio, mais a direção correta.
+    void recover(unsigned historyBefore, bool taken) { history = historyBefore; speculate(taken); }
+
+    template <class Archive> void transfer(Archive &ar) {
+        ar.expect(kind, "branch.predictor");
+        snapshotSized(ar, counters, "branch.table");
+        ar(history);
+    }
+
+    // Commit do desvio: ajusta o contador usado na previsão.
+    void update(int pc, unsigned historyBefore, bool taken) {
+        if (kind == BRANCH_PREDICTOR_STATIC) return;
+        uint8_t &counter = counters[indexOf(pc, historyBefore)];
+        if (taken && counter < 3) counter++;
+        else if (!taken && counter > 0) counter--;
+    }
+};
+
+// --- Trace de eventos do pipeline ---
+// Em vez de reimprimir todas as tabelas a cada ciclo, o trace grava um registro compacto
+// por evento de cada instrução. O volume de saída é proporcional ao trabalho simulado e
+// o arquivo pode ser processado depois (ex: para montar diagramas de pipeline).
+enum TraceFormat { TRACE_CSV, TRACE_JSONL, TRACE_KANATA }; // TRACE_KANATA: ver KanataWriter.
+
+enum TraceEventType {
+    TRACE_ISSUE,         // Instrução emitida: ganhou RS e entrada no ROB.
+    TRACE_EXEC_START,    // Operandos prontos e unidade funcional alocada.
+    TRACE_EXEC_COMPLETE, // Último ciclo de execução.
+    TRACE_WRITE_RESULT,  // Resultado transmitido pelo CDB e escrito no ROB.
+    TRACE_COMMIT,        // Efetivada no estado arquitetural.
+    TRACE_SQUASH,        // Descartada: reexecução após violação de ordem de memória, ou caminho errado de um desvio.
+    TRACE_MISPREDICT,    // Desvio resolvido com a direção mal prevista (value: 1 tomado, 0 não tomado).
+    TRACE_EVENT_COUNT
+};
+
+// Um registro do trace. Os campos opcionais só são gravados nos eventos em que fazem sentido.
+struct TraceRecord {
+    int cycle = 0;
+    TraceEventType event = TRACE_ISSUE;
+    int instructionIndex = -1;
+    InstructionType op = INVALID;
+    int robIndex = -1;
+    RSGroup rsGroup = RS_NONE; int rsSlot = -1; // Issue e início da execução.
+    bool hasTags = false; int qj = TAG_READY, qk = TAG_READY; // Issue: tags pendentes (-1 = pronto).
+    int unit = -1;                              // Início da execução: unidade funcional usada.
+    bool hasValue = false; Word value = 0;      // WriteResult e commit.
+    int destReg = -1, address = 0;              // Commit: registrador de destino (o número na instrução) ou endereço do STORE.
+    const DecodedInstruction *decoded = nullptr; int pc = -1; // Issue: a instrução (válida só durante onEvent) e a sua posição.
+};
+
+// Recebe os eventos do pipeline (um TraceRecord por evento), no lugar da saída de texto.
+// Um programa que usa o simulador como biblioteca implementa onEvent e o registra com
+// setListener(); a chamada acontece no meio do ciclo, então onEvent não pode chamar o simulador.
+class PipelineListener {
+public:
+    virtual ~PipelineListener() {}
+    virtual void onEvent(const TraceRecord &record) = 0;
+};
+
+// Estágios de stepSimulation(), na ordem em que rodam no ciclo.
+enum PipelineStage { STAGE_COMMIT, STAGE_WRITEBACK, STAGE_ISSUE, STAGE_EXECUTE, PIPELINE_STAGE_COUNT };
+
+// Tempo real gasto em cada estágio (setStageProfile). Serve para medir o próprio simulador
+// (tomasulo_bench): ler o relógio duas vezes por estágio custa mais que muitos estágios, então
+// o total fica maior que o de uma execução sem o perfil. O WriteResult inclui os descartes, e o
+// Execute, o início e o avanço da execução.
+struct StageProfile {
+    double seconds[PIPELINE_STAGE_COUNT] = {};
+};
+
+// Escritor bufferizado do trace. Os registros são montados em uma string e gravados
+// em blocos, evitando uma chamada de E/S por evento.
+class TraceWriter : public PipelineListener {
+private:
+    FILE *file = nullptr;
+    TraceFormat format = TRACE_CSV;
+    string buffer;
+    static const size_t FLUSH_THRESHOLD = 64 * 1024;
+
+    void appendInt(long long value) {
+        char digits[24];
+        int length = snprintf(digits, sizeof(digits), "%lld", value);
+        buffer.append(digits, length);
+    }
+
+    // Como registerNameOf, sem criar uma string por registro.
+    void appendRegister(int reg) {
+        if (reg >= INT_REGISTER_BIT) { buffer += 'R'; appendInt(reg - INT_REGISTER_BIT); }
+        else { buffer += 'F'; appendInt(reg); }
+    }
+
+    void writeCsv(const TraceRecord &r) {
+        appendInt(r.cycle); buffer += ',';
+        buffer += traceEventName(r.event); buffer += ',';
+        appendInt(r.instructionIndex); buffer += ',';
+        buffer += instructionTypeName(r.op); buffer += ',';
+        appendInt(r.robIndex); buffer += ',';
+        if (r.rsGroup != RS_NONE) { buffer += rsGroupName(r.rsGroup); appendInt(r.rsSlot); }
+        buffer += ',';
+        if (r.hasTags) appendInt(r.qj);
+        buffer += ',';
+        if (r.hasTags) appendInt(r.qk);
+        buffer += ',';
+        if (r.unit >= 0) appendInt(r.unit);
+        buffer += ',';
+        if (r.hasValue) appendInt(r.value);
+        buffer += ',';
+        if (r.event == TRACE_COMMIT) {
+            if (r.op == STORE) { buffer += "MEM["; appendInt(r.address); buffer += ']'; }
+            else if (r.destReg >= 0) appendRegister(r.destReg);
+        }
+        buffer += '\n';
+    }
+
+    void writeJsonLine(const TraceRecord &r) {
+        buffer += "{\"cycle\":"; appendInt(r.cycle);
+        buffer += ",\"event\":\""; buffer += traceEventName(r.event);
+        buffer += "\",\"inst\":"; appendInt(r.instructionIndex);
+        buffer += ",\"op\":\""; buffer += instructionTypeName(r.op);
+        buffer += "\",\"rob\":"; appendInt(r.robIndex);
+        if (r.rsGroup != RS_NONE) { buffer += ",\"rs\":\""; buffer += rsGroupName(r.rsGroup); appendInt(r.rsSlot); buffer += '"'; }
+        if (r.hasTags) { buffer += ",\"qj\":"; appendInt(r.qj); buffer += ",\"qk\":"; appendInt(r.qk); }
+        if (r.unit >= 0) { buffer += ",\"unit\":"; appendInt(r.unit); }
+        if (r.hasValue) { buffer += ",\"value\":"; appendInt(r.value); }
+        if (r.event == TRACE_COMMIT) {
+            if (r.op == STORE) { buffer += ",\"addr\":"; appendInt(r.address); }
+            else if (r.destReg >= 0) { buffer += ",\"dest\":\""; appendRegister(r.destReg); buffer += '"'; }
+        }
+        buffer += "}\n";
+    }
+
+public:
+    TraceWriter() { buffer.reserve(FLUSH_THRESHOLD + 256); }
+    ~TraceWriter() { close(); }
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+
+    static const char *traceEventName(TraceEventType event) {
+        static const char *names[TRACE_EVENT_COUNT] = {"issue", "exec_start", "exec_complete", "write_result", "commit", "squash", "mispredict"};
+        return names[event];
+    }
+
+    // Abre (ou cria) o arquivo do trace. No formato CSV, grava o cabeçalho das colunas.
+    bool open(const string &path, TraceFormat traceFormat) {
+        close();
+        file = fopen(path.c_str(), "w");
+        if (!file) return false;
+        format = traceFormat;
+        if (format == TRACE_CSV) buffer += "cycle,event,inst,op,rob,rs,qj,qk,unit,value,dest\n";
+        return true;
+    }
+
+    bool isOpen() const { return file != nullptr; }
+
+    void write(const TraceRecord &record) {
+        if (format == TRACE_CSV) writeCsv(record);
+        else writeJsonLine(record);
+        if (buffer.size() >= FLUSH_THRESHOLD) flush();
+    }
+    void onEvent(const TraceRecord &record) override { write(record); }
+
+    void flush() {
+        if (file && !buffer.empty()) fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+    }
+
+    void close() {
+        if (!file) return;
+        flush();
+        fclose(file);
+        file = nullptr;
+    }
+};
+
+// Escritor do log de pipeline no formato Kanata (versão 0004), lido pelo visualizador Konata.
+// Os comandos saem em ordem de ciclo, a partir dos mesmos eventos do trace. Cada instrução
+// emitida vira uma linha com os estágios:
+//   Is  emitida, esperando operandos ou unidade funcional na RS (de issue até exec_start);
+//   Ex  executando (de exec_start até exec_complete, inclusive);
+//   Cd  terminou e espera o CDB (só aparece se o write_result não é no ciclo seguinte);
+//   Wr  resultado escrito, esperando o commit em ordem;
+//   Cm  ciclo do commit.
+// As tags Qj/Qk do issue viram arestas de dependência (comando W) até o produtor. Instruções
+// descartadas (caminho errado ou reexecução) terminam com um flush; emitidas de novo, ganham outra linha.
+class KanataWriter : public PipelineListener {
+private:
+    FILE *file = nullptr;
+    string buffer;
+    static const size_t FLUSH_THRESHOLD = 64 * 1024;
+
+    // Instrução em voo, pela entrada do ROB que ocupa.
+    struct Live {
+        long long id = -1;          // Identificador no log (-1: entrada livre).
+        const char *stage = "";     // Estágio atual.
+        int waitFrom = -1;          // Ciclo em que começa a espera pelo CDB, ainda não registrado (-1: nenhum).
+    };
+    vector<Live> byRob;
+    // Mudanças de estágio no ciclo seguinte a um evento (fim da execução e o retire depois do
+    // commit), em ordem de ciclo. 'retire' < 0: começo da espera pelo CDB.
+    struct Pending { int cycle; int robIndex; long long id; long long retire; };
+    deque<Pending> pending;
+    long long nextId = 0, retiredCount = 0;
+    int currentCycle = 0;  // Ciclo dos próximos comandos.
+    int loggedCycle = 0;   // Ciclo já registrado no log (o avanço só é escrito antes de um comando).
+    bool started = false;
+
+    void appendInt(long long value) {
+        char digits[24];
+        int length = snprintf(digits, sizeof(digits), "%lld", value);
+        buffer.append(digits, length);
+    }
+
+    // Comando "X<tab>id<tab>a<tab>b", precedido do avanço de ciclos pendente.
+    void command(char name, long long id, long long a, const char *b) {
+        if (currentCycle > loggedCycle) {
+            buffer += "C\t"; appendInt(currentCycle - loggedCycle); buffer += '\n';
+            loggedCycle = currentCycle;
+        }
+        buffer += name; buffer += '\t'; appendInt(id); buffer += '\t'; appendInt(a); buffer += '\t'; buffer += b; buffer += '\n';
+    }
+    void command(char name, long long id, long long a, long long b) {
+        char digits[24];
+        snprintf(digits, sizeof(digits), "%lld", b);
+        command(name, id, a, digits);
+    }
+
+    void startStage(Live &live, const char *stage) { command('S', live.id, 0, stage); live.stage = stage; }
+    void endStage(Live &live) { command('E', live.id, 0, live.stage); }
+
+    // Leva o log até 'cycle', aplicando no caminho as mudanças pendentes de ciclos anteriores.
+    // As de 'cycle' ficam para depois: um evento da própria instrução neste ciclo as substitui.
+    void advanceTo(int cycle) {
+        if (!started) {
+            buffer += "C=\t"; appendInt(cycle); buffer += '\n';
+            currentCycle = loggedCycle = cycle;
+            started = true;
+        }
+        applyPendingBefore(cycle);
+        currentCycle = cycle;
+    }
+
+    void applyPendingBefore(int cycle) {
+        while (!pending.empty() && pending.front().cycle < cycle) {
+            Pending change = pending.front();
+            pending.pop_front();
+            currentCycle = change.cycle;
+            if (change.retire >= 0) {
+                command('R', change.id, change.retire, 0LL);
+            } else {
+                Live &live = byRob[change.robIndex];
+                if (live.id != change.id || live.waitFrom != change.cycle) continue; // Já substituída.
+                endStage(live);
+                startStage(live, "Cd");
+                live.waitFrom = -1;
+            }
+        }
+    }
+
+    Live &liveAt(int robIndex) {
+        if (robIndex >= static_cast<int>(byRob.size())) byRob.resize(robIndex + 1);
+        return byRob[robIndex];
+    }
+
+public:
+    KanataWriter() { buffer.reserve(FLUSH_THRESHOLD + 256); }
+    ~KanataWriter() { close(); }
+    KanataWriter(const KanataWriter &) = delete;
+    KanataWriter &operator=(const KanataWriter &) = delete;
+
+    bool open(const string &path) {
+        close();
+        file = fopen(path.c_str(), "w");
+        if (!file) return false;
+        buffer += "Kanata\t0004\n";
+        return true;
+    }
+
+    bool isOpen() const { return file != nullptr; }
+
+    void onEvent(const TraceRecord &r) override {
+        if (r.robIndex < 0) return;
+        advanceTo(r.cycle);
+        Live &live = liveAt(r.robIndex);
+        switch (r.event) {
+            case TRACE_ISSUE: {
+                live = Live();
+                live.id = nextId++;
+                buffer += "I\t"; appendInt(live.id); buffer += '\t'; appendInt(r.instructionIndex); buffer += "\t0\n";
+                string label = to_string(r.instructionIndex) + ": " + (r.decoded ? decodedInstructionText(*r.decoded) : instructionTypeName(r.op));
+                command('L', live.id, 0, label.c_str());
+                string detail = "pc=" + to_string(r.pc) + " rob=" + to_string(r.robIndex);
+                if (r.rsGroup != RS_NONE) detail += string(" rs=") + rsGroupName(r.rsGroup) + to_string(r.rsSlot);
+                command('L', live.id, 1, detail.c_str());
+                // Dependências: as entradas do ROB que produzirão os operandos pendentes.
+                int tags[2] = {r.hasTags ? r.qj : TAG_READY, r.hasTags ? r.qk : TAG_READY};
+                for (int t = 0; t < 2; ++t) {
+                    if (tags[t] == TAG_READY || (t == 1 && tags[1] == tags[0])) continue;
+                    const Live &producer = liveAt(tags[t]);
+                    if (producer.id >= 0) command('W', live.id, producer.id, 0LL);
+                }
+                startStage(live, r.op == JUMP ? "Wr" : "Is"); // O salto fica pronto já na emissão.
+                break;
+            }
+            case TRACE_EXEC_START:
+                if (live.id < 0) break;
+                endStage(live);
+                startStage(live, "Ex");
+                break;
+            case TRACE_EXEC_COMPLETE:
+                if (live.id < 0) break;
+                live.waitFrom = r.cycle + 1;
+                pending.push_back({r.cycle + 1, r.robIndex, live.id, -1});
+                break;
+            case TRACE_WRITE_RESULT:
+                if (live.id < 0) break;
+                endStage(live); // Ex (sem espera pelo CDB) ou Cd.
+                live.waitFrom = -1;
+                startStage(live, "Wr");
+                break;
+            case TRACE_COMMIT:
+                if (live.id < 0) break;
+                endStage(live);
+                startStage(live, "Cm");
+                pending.push_back({r.cycle + 1, r.robIndex, live.id, retiredCount++});
+                live = Live();
+                break;
+            case TRACE_SQUASH:
+                if (live.id < 0) break;
+                command('R', live.id, 0, 1LL);
+                live = Live();
+                break;
+            case TRACE_MISPREDICT:
+                if (live.id >= 0) command('L', live.id, 1, " desvio mal previsto");
+                break;
+            default: break;
+        }
+        if (buffer.size() >= FLUSH_THRESHOLD) flush();
+    }
+
+    void flush() {
+        if (file && !buffer.empty()) fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+    }
+
+    // Aplica as mudanças pendentes (os retires do último ciclo) e fecha o arquivo.
+    void close() {
+        if (!file) return;
+        applyPendingBefore(numeric_limits<int>::max());
+        flush();
+        fclose(file);
+        file = nullptr;
+    }
+};
+
+// --- Snapshot do estado ---
+// O estado completo do simulador pode ser gravado e restaurado (checkpoint). O formato é
+// binário e compacto: o cabeçalho (assinatura, versão e a descrição da máquina no formato
+// de --config) e depois os campos em sequência, na ordem de bytes da máquina, sem padding.
+// Cada estrutura tem um método transfer(ar) que lista os seus campos uma única vez; o mesmo
+// método grava (SnapshotWriter) e restaura (SnapshotReader). Tamanhos que vêm da máquina
+// (RSs, ROB, caches...) são só conferidos: o snapshot é restaurado em uma máquina de mesma forma.
+const char SNAPSHOT_MAGIC[4] = {'T', 'O', 'M', 'S'};
+const uint32_t SNAPSHOT_VERSION = 5;
+
+template <class Archive, class T>
+typename enable_if<is_arithmetic<T>::value>::type snapshotField(Archive &ar, T &value) { ar.raw(&value, sizeof(value)); }
+template <class Archive>
+void snapshotField(Archive &ar, bool &value) {
+    uint8_t stored = value ? 1 : 0;
+    ar.raw(&stored, sizeof(stored));
+    value = stored != 0;
+}
+template <class Archive, class T>
+typename enable_if<is_enum<T>::value>::type snapshotField(Archive &ar, T &value) {
+    int32_t stored = static_cast<int32_t>(value);
+    ar.raw(&stored, sizeof(stored));
+    value = static_cast<T>(stored);
+}
+template <class Archive, class T>
+typename enable_if<is_class<T>::value>::type snapshotField(Archive &ar, T &value) { value.transfer(ar); }
+
+// Vetor de tamanho variável (ex: filas, listas de prontas).
+template <class Archive, class T>
+void snapshotItems(Archive &ar, vector<T> &items) {
+    uint64_t count = items.size();
+    ar(count);
+    if (ar.loading()) {
+        if (!ar.ok() || count > ar.remaining()) { ar.fail("snapshot truncado"); return; }
+        items.assign(static_cast<size_t>(count), T());
+    }
+    for (size_t i = 0; i < items.size() && ar.ok(); ++i) ar(items[i]);
+}
+
+// Vetor (ou array) com o tamanho dado pela máquina: o tamanho do snapshot precisa ser o mesmo.
+template <class Archive, class T>
+void snapshotSized(Archive &ar, vector<T> &items, const char *what) {
+    ar.expect(static_cast<uint64_t>(items.size()), what);
+    for (size_t i = 0; i < items.size() && ar.ok(); ++i) ar(items[i]);
+}
+template <class Archive, class T, size_t N>
+void snapshotSized(Archive &ar, array<T, N> &items, const char *what) {
+    ar.expect(static_cast<uint64_t>(N), what);
+    for (size_t i = 0; i < N && ar.ok(); ++i) ar(items[i]);
+}
+
+class SnapshotWriter {
+private:
+    string bytes;
+
+public:
+    bool loading() const { return false; }
+    bool ok() const { return true; }
+    size_t remaining() const { return numeric_limits<size_t>::max(); }
+    void fail(const string &) {}
+    void raw(const void *data, size_t size) { bytes.append(static_cast<const char *>(data), size); }
+    template <class T> void operator()(T &value) { snapshotField(*this, value); }
+    template <class T> void expect(const T &current, const char *) { T value = current; (*this)(value); }
+    void text(string &value) {
+        uint64_t size = value.size();
+        (*this)(size);
+        raw(value.data(), value.size());
+    }
+
+    void header(string machineText) {
+        raw(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        uint32_t version = SNAPSHOT_VERSION;
+        (*this)(version);
+        text(machineText);
+    }
+
+    const string &data() const { return bytes; }
+};
+
+class SnapshotReader {
+private:
+    const char *cursor, *end;
+    string error;
+
+public:
+    explicit SnapshotReader(const string &bytes) : cursor(bytes.data()), end(bytes.data() + bytes.size()) {}
+
+    bool loading() const { return true; }
+    bool ok() const { return error.empty(); }
+    const string &getError() const { return error; }
+    size_t remaining() const { return static_cast<size_t>(end - cursor); }
+    void fail(const string &message) { if (error.empty()) error = message; }
+    void raw(void *data, size_t size) {
+        if (!ok() || size > remaining()) { fail("snapshot truncado"); memset(data, 0, size); return; }
+        memcpy(data, cursor, size);
+        cursor += size;
+    }
+    template <class T> void operator()(T &value) { snapshotField(*this, value); }
+    // Campo que precisa ser igual ao da máquina atual.
+    template <class T> void expect(const T &current, const char *what) {
+        T stored = T();
+        (*this)(stored);
+        if (ok() && stored != current) {
+            fail(string("snapshot incompativel com a maquina: ") + what + " (snapshot " + to_string(static_cast<long long>(stored)) +
+                 ", maquina " + to_string(static_cast<long long>(current)) + ")");
+        }
+    }
+    void text(string &value) {
+        uint64_t size = 0;
+        (*this)(size);
+        if (!ok() || size > remaining()) { fail("snapshot truncado"); return; }
+        value.assign(cursor, static_cast<size_t>(size));
+        cursor += size;
+    }
+
+    // Lê o cabeçalho; 'machineText' recebe a descrição da máquina gravada.
+    bool header(string &machineText) {
+        char magic[sizeof(SNAPSHOT_MAGIC)];
+        raw(magic, sizeof(magic));
+        if (ok() && memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0) fail("assinatura invalida");
+        uint32_t version = 0;
+        (*this)(version);
+        if (ok() && version != SNAPSHOT_VERSION) fail("versao nao suportada " + to_string(version));
+        text(machineText);
+        return ok();
+    }
+};
+
+// Lê um arquivo de snapshot inteiro para 'data'.
+inline bool readSnapshotFile(const string &path, string &data, ostream &err) {
+    ifstream file(path.c_str(), ios::binary);
+    if (!file.is_open()) {
+        err << "Erro ao abrir snapshot: " << path << endl;
+        return false;
+    }
+    ostringstream contents;
+    contents << file.rdbuf();
+    data = contents.str();
+    return true;
+}
+
+// --- Forma da máquina ---
+// O núcleo do simulador (TomasuloSimulatorCore) é parametrizado pela forma da máquina:
+// quantidade de RSs de cada grupo, tamanho do ROB e latências. DynamicShape lê esses
+// valores da MachineConfig em tempo de execução (usado na exploração). FixedShape os
+// fixa em tempo de compilação: o armazenamento vira std::array, os laços sobre as RSs
+// têm tamanho conhecido e os módulos pelo tamanho do ROB/roda viram constantes.
+// As duas formas produzem exatamente os mesmos resultados.
+
+// Máximo avaliável em tempo de compilação (std::max só é constexpr a partir do C++14).
+constexpr int constMax(int a, int b) { return a > b ? a : b; }
+
+// Índice do bit 1 menos significativo ('bits' não pode ser zero).
+inline int lowestSetBit(uint64_t bits) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int index = 0;
+    while (!(bits & 1)) { bits >>= 1; ++index; }
+    return index;
+#endif
+}
+
+// Ajusta o tamanho do armazenamento: vetores são redimensionados; arrays já têm o tamanho fixo.
+template <class T> void sizeStorage(vector<T> &storage, int count) { storage.resize(count); }
+template <class T, size_t N> void sizeStorage(array<T, N> &, int) {}
+
+struct DynamicShape {
+    typedef vector<ReservationStation> AddStations, MulStations, LoadStations, StoreStations, FpAddStations, FpMulStations;
+    typedef vector<ReorderBufferEntry> ReorderBuffer;
+    const int ADD_RS_COUNT, MUL_RS_COUNT, LOAD_RS_COUNT, STORE_RS_COUNT, FPADD_RS_COUNT, FPMUL_RS_COUNT;
+    const int THREAD_COUNT;      // Threads de hardware (SMT).
+    const int ROB_SIZE;          // Entradas do ROB de cada thread (a partição de rob / smt.threads).
+    const int ADD_LATENCY, MUL_LATENCY, DIV_LATENCY, LOAD_LATENCY, STORE_LATENCY;
+    const int WHEEL_SIZE;        // Baldes da roda de execução: a maior latência + 1.
+    const int FETCH_WINDOW_SIZE; // Instruções em voo e a próxima a ser emitida.
+
+    explicit DynamicShape(const MachineConfig &config) :
+        ADD_RS_COUNT(config.addRS), MUL_RS_COUNT(config.mulRS), LOAD_RS_COUNT(config.loadRS), STORE_RS_COUNT(config.storeRS),
+        FPADD_RS_COUNT(config.fpAddRS), FPMUL_RS_COUNT(config.fpMulRS),
+        THREAD_COUNT(config.threadCount), ROB_SIZE(config.robSize / config.threadCount),
+        ADD_LATENCY(config.addLatency), MUL_LATENCY(config.mulLatency), DIV_LATENCY(config.divLatency),
+        LOAD_LATENCY(config.loadLatency), STORE_LATENCY(config.storeLatency),
+        WHEEL_SIZE(constMax(constMax(constMax(ADD_LATENCY, MUL_LATENCY), constMax(DIV_LATENCY, LOAD_LATENCY)),
+                            constMax(STORE_LATENCY, constMax(worstMemoryAccessLatency(config), worstFloatingPointLatency(config)))) + 1),
+        FETCH_WINDOW_SIZE(ROB_SIZE + 1) {}
+};
+
+template <int ADD_RS, int MUL_RS, int LOAD_RS, int STORE_RS, int FPADD_RS, int FPMUL_RS, int ROB,
+          int ADD_LAT, int MUL_LAT, int DIV_LAT, int LOAD_LAT, int STORE_LAT>
+struct FixedShape {
+    typedef array<ReservationStation, ADD_RS> AddStations;
+    typedef array<ReservationStation, MUL_RS> MulStations;
+    typedef array<ReservationStation, LOAD_RS> LoadStations;
+    typedef array<ReservationStation, STORE_RS> StoreStations;
+    typedef array<ReservationStation, FPADD_RS> FpAddStations;
+    typedef array<ReservationStation, FPMUL_RS> FpMulStations;
+    typedef array<ReorderBufferEntry, ROB> ReorderBuffer;
+    static constexpr int ADD_RS_COUNT = ADD_RS, MUL_RS_COUNT = MUL_RS, LOAD_RS_COUNT = LOAD_RS, STORE_RS_COUNT = STORE_RS;
+    static constexpr int FPADD_RS_COUNT = FPADD_RS, FPMUL_RS_COUNT = FPMUL_RS;
+    static constexpr int THREAD_COUNT = 1; // SMT só no núcleo dinâmico.
+    static constexpr int ROB_SIZE = ROB;
+    static constexpr int ADD_LATENCY = ADD_LAT, MUL_LATENCY = MUL_LAT, DIV_LATENCY = DIV_LAT;
+    static constexpr int LOAD_LATENCY = LOAD_LAT, STORE_LATENCY = STORE_LAT;
+    static constexpr int WHEEL_SIZE = constMax(constMax(constMax(ADD_LAT, MUL_LAT), constMax(DIV_LAT, LOAD_LAT)), constMax(STORE_LAT, 1)) + 1;
+    static constexpr int FETCH_WINDOW_SIZE = ROB + 1;
+
+    // Os parâmetros da forma já estão fixos; os demais (larguras, registradores, memória,
+    // unidades funcionais) continuam vindo da MachineConfig.
+    explicit FixedShape(const MachineConfig &) {}
+
+    // A descrição da máquina tem exatamente esta forma? Os acessos aos caches e as operações de
+    // ponto flutuante também precisam caber na roda de execução, que aqui tem tamanho fixo.
+    static bool matches(const MachineConfig &config) {
+        return worstMemoryAccessLatency(config) < WHEEL_SIZE && worstFloatingPointLatency(config) < WHEEL_SIZE && config.threadCount == 1 && config.addRS == ADD_RS && config.mulRS == MUL_RS && config.loadRS == LOAD_RS && config.storeRS == STORE_RS &&
+               config.fpAddRS == FPADD_RS && config.fpMulRS == FPMUL_RS && config.robSize == ROB && config.addLatency == ADD_LAT && config.mulLatency == MUL_LAT &&
+               config.divLatency == DIV_LAT && config.loadLatency == LOAD_LAT && config.storeLatency == STORE_LAT;
+    }
+
+    // Grava esta forma na descrição da máquina (usado por --preset).
+    static void applyTo(MachineConfig &config) {
+        config.addRS = ADD_RS; config.mulRS = MUL_RS; config.loadRS = LOAD_RS; config.storeRS = STORE_RS;
+        config.fpAddRS = FPADD_RS; config.fpMulRS = FPMUL_RS;
+        config.robSize = ROB;
+        config.addLatency = ADD_LAT; config.mulLatency = MUL_LAT; config.divLatency = DIV_LAT;
+        config.loadLatency = LOAD_LAT; config.storeLatency = STORE_LAT;
+    }
+};
+
+// Definições dos membros constexpr (necessárias no C++11 quando usados por referência, ex: em max()).
+#define TOMASULO_FIXED_SHAPE_TEMPLATE template <int A, int M, int L, int S, int FA, int FM, int R, int LA, int LM, int LD, int LL, int LS>
+#define TOMASULO_FIXED_SHAPE FixedShape<A, M, L, S, FA, FM, R, LA, LM, LD, LL, LS>
+TOMASULO_FIXED_SHAPE_TEMPLATE constexpr int TOMASULO_FIXED_SHAPE::ADD_RS_COUNT;
+TOMASULO_FIXED_SHAPE_TEMPLATE constexpr int TOMASULO_FIXED_SHAPE::MUL_RS_COUNT;
+TOMASULO_FIXED_SHAPE_TEMPLATE constexpr int TOMASULO_FIXED_SHAPE::LOAD_RS_COUNT;
+TOMASULO_FIXED_SHAPE_TEMPLATE constexpr int TOMASULO_FIXED_SHAPE::STORE_RS_COUNT;
+TOMASULO_FIXED_SHAPE_TEMPLATE constexpr int TOMASULO_FIXED_SHAPE::FPADD_RS_COUNT;
+TOMASULO_FIXED_SHAPE_TEMPLATE constexpr int TOMASULO_FIXED_SHAPE::FPMUL_RS_COUNT;
+TOMASULO_FIXED_SHAPE_TEMPLATE constexpr int TOMASULO_FIXED_SHAPE::THREAD_COUNT;
+TOMASULO_FIXED_SHAPE_TEMPLATE constexpr int TOMASULO_FIXED_SHAPE::ROB_SIZE;
+TOMASULO_FIXED_SHAPE_TEMPLATE constexpr int TOMASULO_FIXED_SHAPE::ADD_LATENCY;
+TOMASULO_FIXED_SHAPE_TEMPLATE constexpr int TOMASULO_FIXED_SHAPE::MUL_LATENCY;
+TOMASULO_FIXED_SHAPE_TEMPLATE constexpr int TOMASULO_FIXED_SHAPE::DIV_LATENCY;
+TOMASULO_FIXED_SHAPE_TEMPLATE constexpr int TOMASULO_FIXED_SHAPE::LOAD_LATENCY;
+TOMASULO_FIXED_SHAPE_TEMPLATE constexpr int TOMASULO_FIXED_SHAPE::STORE_LATENCY;
+TOMASULO_FIXED_SHAPE_TEMPLATE constexpr int TOMASULO_FIXED_SHAPE::WHEEL_SIZE;
+TOMASULO_FIXED_SHAPE_TEMPLATE constexpr int TOMASULO_FIXED_SHAPE::FETCH_WINDOW_SIZE;
+#undef TOMASULO_FIXED_SHAPE
+#undef TOMASULO_FIXED_SHAPE_TEMPLATE
+
+// Formas especializadas disponíveis (--preset). Uma descrição de máquina com uma destas
+// formas usa automaticamente o núcleo especializado (a menos de --core dynamic).
+typedef FixedShape<3, 2, 3, 3, 3, 2, 16, 2, 10, 40, 2, 2> DefaultShape; // "padrao": o modelo original.
+typedef FixedShape<2, 1, 2, 2, 2, 1, 8, 2, 10, 40, 2, 2> SmallShape;    // "pequena".
+typedef FixedShape<6, 4, 6, 6, 6, 4, 64, 2, 10, 40, 2, 2> WideShape;    // "larga".
+
+struct MachinePreset {
+    const char *name;
+    void (*applyTo)(MachineConfig &config);
+    bool (*matches)(const MachineConfig &config);
+};
+const MachinePreset machinePresets[] = {
+    {"padrao", DefaultShape::applyTo, DefaultShape::matches},
+    {"pequena", SmallShape::applyTo, SmallShape::matches},
+    {"larga", WideShape::applyTo, WideShape::matches},
+};
+const int MACHINE_PRESET_COUNT = sizeof(machinePresets) / sizeof(machinePresets[0]);
+
+// Forma especializada com a forma da máquina, ou nullptr se nenhuma corresponder.
+inline const MachinePreset *findMatchingPreset(const MachineConfig &config) {
+    for (int i = 0; i < MACHINE_PRESET_COUNT; ++i) {
+        if (machinePresets[i].matches(config)) return &machinePresets[i];
+    }
+    return nullptr;
+}
+
+// Qual núcleo executar (--core).
+enum CoreMode { CORE_AUTO, CORE_DYNAMIC, CORE_FIXED };
+
+// --- Análise do fluxo de dados ---
+// Limite do programa, independente da janela: o grafo de dependências RAW (registradores, com
+// as mesmas fontes da emissão, e memória, de um STORE para os LOADs seguintes do mesmo endereço)
+// ao longo do caminho realmente executado, com as latências da máquina e recursos infinitos.
+// Uma instrução começa quando o último dos seus produtores termina; o caminho crítico é a
+// cadeia que termina mais tarde. Ver TomasuloSimulatorCore::analyzeDataflow().
+struct DataflowChainEntry {
+    int instructionIndex = -1;   // Índice dinâmico (ordem de execução).
+    int pc = 0;
+    DecodedInstruction decoded = DecodedInstruction();
+    long long start = 0, end = 0; // Ciclos (relativos) em que a instrução começa e termina no caminho crítico.
+};
+
+struct DataflowReport {
+    long long instructions = 0;       // Instruções analisadas.
+    long long criticalPathCycles = 0; // Comprimento do caminho crítico.
+    long long chainLength = 0;        // Instruções no caminho crítico.
+    long long chainOps[INVALID + 1] = {};    // Instruções do caminho crítico, por tipo.
+    long long chainCycles[INVALID + 1] = {}; // Ciclos do caminho crítico, por tipo.
+    long long memoryEdges = 0;        // Dependências STORE -> LOAD pela memória.
+    vector<DataflowChainEntry> chainHead, chainTail; // Primeiras e últimas instruções da cadeia crítica.
+
+    // IPC com recursos infinitos: limitado só pelo caminho crítico.
+    double idealIPC() const { return criticalPathCycles > 0 ? static_cast<double>(instructions) / criticalPathCycles : 0.0; }
+};
+
+// Imprime o relatório da análise. 'issueWidth' dá o limite da emissão (uma instrução por
+// posição de emissão por ciclo), o outro limite que não depende da janela.
+inline void writeDataflowReport(ostream &out, const DataflowReport &report, int issueWidth) {
+    char line[160];
+    out << "\nAnalise do fluxo de dados (dependencias RAW, latencias da maquina, recursos infinitos):\n";
+    out << "  Instrucoes: " << report.instructions << "\n";
+    out << "  Caminho critico: " << report.criticalPathCycles << " ciclos (" << report.chainLength << " instrucoes)\n";
+    snprintf(line, sizeof(line), "  IPC ideal (fluxo de dados): %.4f\n", report.idealIPC());
+    out << line;
+    out << "  Limite da emissao (issue_width = " << issueWidth << "): " << (report.instructions + issueWidth - 1) / issueWidth << " ciclos\n";
+    out << "  Dependencias pela memoria (STORE -> LOAD): " << report.memoryEdges << "\n";
+    if (report.chainLength == 0) return;
+    out << "  Composicao do caminho critico:\n";
+    for (int t = 0; t <= INVALID; ++t) {
+        if (report.chainOps[t] == 0) continue;
+        snprintf(line, sizeof(line), "    %-6s %10lld instrucoes %12lld ciclos (%.1f%%)\n", instructionTypeName(static_cast<InstructionType>(t)),
+                 report.chainOps[t], report.chainCycles[t], 100.0 * report.chainCycles[t] / report.criticalPathCycles);
+        out << line;
+    }
+    out << "  Cadeia critica" << (report.chainTail.empty() ? "" : " (inicio e fim)") << ":\n";
+    auto printEntries = [&](const vector<DataflowChainEntry> &entries) {
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const DataflowChainEntry &entry = entries[i];
+            snprintf(line, sizeof(line), "    inst %-9d pc %-6d %-20s ciclos %lld-%lld\n", entry.instructionIndex, entry.pc,
+                     decodedInstructionText(entry.decoded).c_str(), entry.start, entry.end);
+            out << line;
+        }
+    };
+    printEntries(report.chainHead);
+    if (!report.chainTail.empty()) {
+        out << "    ... (" << report.chainLength - report.chainHead.size() - report.chainTail.size() << " instrucoes)\n";
+        printEntries(report.chainTail);
+    }
+}
+
+// --- Co-simulação ---
+// Modelo de referência: interpretador em ordem, uma instrução por vez, com a semântica
+// arquitetural (a mesma do WriteResult e do Commit) sobre cópias próprias dos registradores e
+// da memória. Com a co-simulação ligada, cada commit do pipeline é comparado com o passo
+// correspondente do modelo (ver TomasuloSimulatorCore::enableCosimulation()).
+class ReferenceModel {
+public:
+    // Efeito arquitetural de uma instrução.
+    struct Effect {
+        int destReg = -1;      // Registrador escrito (índice no banco, ver registerIndex; -1: nenhum).
+        Word value = 0;        // Valor escrito no registrador ou na memória.
+        int address = -1;      // STORE: endereço escrito (-1 se inválido).
+        bool taken = false;    // Desvios: tomado?
+        int nextPC = 0;
+    };
+
+    ReferenceModel() : memory(0, MEMORY_FILL_IDENTITY) {}
+    // 'fpCount': registradores F no início de 'initialRegisters' (os R vêm depois).
+    ReferenceModel(const vector<Word> &initialRegisters, int fpCount, const SparseMemory &initialMemory, int startPC)
+        : registers(initialRegisters), fpRegisterCount(fpCount), memory(initialMemory), currentPC(startPC) {}
+
+    int pc() const { return currentPC; }
+    Word reg(int index) const { return registers[index]; }
+
+    // Executa 'inst' (a instrução da posição pc()) e avança o pc. Os erros (divisão por zero,
+    // endereço inválido) têm o mesmo resultado do pipeline, que já os reporta.
+    Effect step(const DecodedInstruction &inst) {
+        Effect effect;
+        effect.nextPC = currentPC + 1;
+        // Operandos como no Issue: src1 e src2 (o imediato em ADDI/SUBI; a base em LOAD/STORE).
+        Word a = operand(inst.src1), b = usesImmediate(inst.type()) ? inst.imm : operand(inst.src2);
+        switch (inst.type()) {
+            case LOAD: {
+                int address = effectiveAddress(inst.imm, b);
+                effect.value = memory.contains(address) ? memory.read(address) : 0;
+                break;
+            }
+            case STORE: {
+                int address = effectiveAddress(inst.imm, b);
+                effect.value = a;
+                if (memory.contains(address)) { memory.write(address, effect.value); effect.address = address; }
+                break;
+            }
+            case BEQ: case BNE:
+                effect.taken = (a == b) == (inst.type() == BEQ);
+                if (effect.taken) effect.nextPC = inst.imm;
+                break;
+            case JUMP: effect.taken = true; effect.nextPC = inst.imm; break;
+            case INVALID: break;
+            default: effect.value = arithmeticResult(inst.type(), a, b); break;
+        }
+        if (inst.destReg() >= 0) {
+            effect.destReg = registerIndex(inst.dest, fpRegisterCount);
+            registers[effect.destReg] = effect.value;
+        }
+        currentPC = effect.nextPC;
+        return effect;
+    }
+
+private:
+    vector<Word> registers;
+    int fpRegisterCount = 0;
+    SparseMemory memory;
+    int currentPC = 0;
+
+    Word operand(uint16_t reg) const { return reg == NO_REGISTER ? 0 : registers[registerIndex(reg, fpRegisterCount)]; }
+};
+
+// Classe principal do simulador, encapsula toda a lógica e os componentes.
+// 'Shape' é DynamicShape (TomasuloSimulator) ou uma FixedShape.
+template <class Shape>
+class TomasuloSimulatorCore : private Shape {
+private:
+    using Shape::ADD_RS_COUNT; using Shape::MUL_RS_COUNT; using Shape::LOAD_RS_COUNT; using Shape::STORE_RS_COUNT;
+    using Shape::FPADD_RS_COUNT; using Shape::FPMUL_RS_COUNT;
+    using Shape::ROB_SIZE;
+    using Shape::ADD_LATENCY; using Shape::MUL_LATENCY; using Shape::DIV_LATENCY; using Shape::LOAD_LATENCY; using Shape::STORE_LATENCY;
+    using Shape::WHEEL_SIZE; using Shape::FETCH_WINDOW_SIZE; using Shape::THREAD_COUNT;
+
+    // --- Componentes Centrais do Processador Simulado ---
+    // Instrução buscada e ainda não cometida: a instrução decodificada e o seu timing.
+    // O índice da instrução é a ordem dinâmica (de busca); 'pc' é a sua posição no programa.
+    struct InFlightInstruction {
+        DecodedInstruction decoded;
+        Instruction timing;
+        int pc = 0;
+        bool predictedTaken = false; // Desvio: direção seguida pela busca.
+        unsigned historyBefore = 0;  // Desvio: histórico global usado na previsão.
+
+        template <class Archive> void transfer(Archive &ar) { ar(decoded); ar(timing); ar(pc); ar(predictedTaken); ar(historyBefore); }
+    };
+    Program program;                            // Programa inteiro (texto lido de uma vez ou binário mapeado).
+    const Program *activeProgram = &program;    // Programa em uso: 'program' ou um compartilhado (useProgram).
+    ifstream streamFile;                        // Modo streaming: arquivo de texto lido sob demanda.
+    string streamFilename;                      // Nome de 'streamFile' (a impressão digital do snapshot o relê).
+    string streamLine;                          // Linha atual do modo streaming (reaproveitada).
+    bool streaming = false;                     // As instruções vêm de 'streamFile' em vez de 'program'?
+    bool sourceExhausted = false;               // A fonte de instruções já foi lida até o fim?
+    int fetchPC = 0;                            // Posição no programa da próxima instrução a buscar.
+    // Janela de busca: buffer circular com as instruções [committedCount, fetchedCount).
+    // Cabem todas as instruções em voo (no máximo ROB_SIZE) mais a próxima a ser emitida,
+    // então a memória não depende do tamanho do programa.
+    vector<InFlightInstruction> fetchWindow;
+    int fetchedCount = 0;                       // Instruções já trazidas da fonte.
+    int committedCount = 0;                     // Instruções já cometidas (e removidas da janela).
+    bool keepHistory = true;                    // Guarda as instruções cometidas (para printStatus)?
+    vector<InFlightInstruction> history;        // Instruções cometidas, por índice, se keepHistory.
+    int historyStart = 0;                       // Índice de history[0] (o ponto de restauração de um snapshot).
+    // Co-simulação (enableCosimulation): o modelo de referência e os últimos commits conferidos.
+    struct CheckedCommit { int instructionIndex; int pc; DecodedInstruction decoded; ReferenceModel::Effect effect; };
+    static const int COSIM_CONTEXT = 8;         // Commits anteriores mostrados numa divergência.
+    bool cosimEnabled = false;
+    bool cosimDiverged = false;
+    ReferenceModel reference;
+    long long cosimChecked = 0;                 // Commits conferidos.
+    CheckedCommit recentCommits[COSIM_CONTEXT]; // Buffer circular, indexado por cosimChecked.
+    // Grupos de Estações de Reserva, por tipo, e o Reorder Buffer (vetores ou arrays, conforme a forma).
+    typename Shape::AddStations addRS;
+    typename Shape::MulStations mulRS;
+    typename Shape::LoadStations loadRS;
+    typename Shape::StoreStations storeRS;
+    typename Shape::FpAddStations fpAddRS;
+    typename Shape::FpMulStations fpMulRS;
+    typename Shape::ReorderBuffer rob;
+    vector<Word> registers;                     // Banco de registradores arquiteturais (F0 -> 0; os R depois dos F, ver registerIndex).
+    vector<RegisterStatus> regStatus;           // Tabela de status dos registradores para renomeação (rename = rob).
+    const int FP_REGISTER_COUNT;                // Quantidade de registradores F (F0..F{FP_REGISTER_COUNT-1}).
+    const int REGISTER_COUNT;                   // Registradores arquiteturais: os F e os R (registers.int).
+    // rename = prf: os resultados ficam no banco de registradores físicos. A tabela de mapeamento
+    // aponta cada registrador arquitetural para o físico com o valor mais recente (especulativo);
+    // o destino de cada instrução emitida recebe um físico da lista livre, e o mapeamento anterior
+    // é liberado no commit. O broadcast no CDB só limpa as tags: nenhum valor é copiado para as RSs.
+    // 'registers' continua com o estado cometido (impressão, snapshot e modo funcional).
+    const RenameMode RENAME_MODE;
+    const int PHYSICAL_REGISTER_COUNT;          // Registradores físicos (0 com rename = rob).
+    vector<int> renameMap;                      // Registrador arquitetural -> físico.
+    vector<Word> physicalValues;                // Valor de cada registrador físico.
+    vector<uint8_t> physicalReady;              // O valor do registrador físico já foi escrito?
+    vector<int> physicalProducer;               // Entrada do ROB que escreve o físico (enquanto não pronto).
+    deque<int> freePhysical;                    // Lista livre, em ordem de alocação.
+    const int MEMORY_SIZE;                      // Palavras de memória.
+    SparseMemory memory;                        // Simulação da memória principal (esparsa, paginada).
+    // Fila de LOADs/STOREs: os índices do ROB dos LOADs e dos STOREs em voo, em ordem de programa.
+    // O LOAD é verificado contra os STOREs mais antigos antes de acessar a memória.
+    const MemoryOrderMode MEMORY_ORDER;
+    deque<int> loadQueue, storeQueue;
+    int replayFrom = -1;                        // Instrução mais antiga a reexecutar ao fim do WriteResult (-1: nenhuma).
+    CacheHierarchy caches;                      // Caches entre os LOADs/STOREs e 'memory' (pode estar desligada).
+    BranchPredictor predictor;                  // Direção dos desvios condicionais, consultada na busca.
+    int mispredictedBranch = -1;                // Desvio mais antigo mal previsto neste WriteResult (-1: nenhum).
+
+    // --- Variáveis para Controle da Simulação ---
+    int cycle = 0;                          // Contador de ciclos da simulação.
+    int nextInstructionIndex = 0;           // Aponta para a próxima instrução a ser emitida do programa.
+    int robHead = 0, robTail = 0;           // Ponteiros para a fila circular do ROB (cabeça e cauda).
+    int robEntriesAvailable;                // Contador de entradas livres no ROB.
+    bool commitLogEnabled = true;           // Imprime uma linha por commit? Desligado no modo batch.
+    // Saída das impressões e dos erros desta instância (não usa cout/cerr diretamente,
+    // para várias instâncias poderem rodar em paralelo).
+    ostream *out = &cout;
+    ostream *err = &cerr;
+
+    // --- Parâmetros de Configuração do Simulador ---
+    // Latências das unidades funcionais e tamanho do ROB vêm da forma (Shape).
+    // Larguras superescalares: instruções emitidas, resultados no CDB (número de CDBs)
+    // e instruções cometidas por ciclo.
+    const int ISSUE_WIDTH, CDB_COUNT, COMMIT_WIDTH;
+    // Latências das operações de ponto flutuante (fora da forma: como os caches, só precisam caber na roda).
+    const int FP_ADD_LATENCY, FP_MUL_LATENCY, FP_DIV_LATENCY;
+    // Unidades funcionais, por tipo. Por padrão há uma unidade pipelined por RS do grupo,
+    // o que equivale a não haver contenção (cada RS executa no máximo uma instrução).
+    FunctionalUnitPool fuPools[FU_TYPE_COUNT];
+
+    // --- Estruturas Auxiliares para a Fase de Execução ---
+    // Evento de conclusão de uma instrução que está (ou esteve) em uma unidade funcional.
+    // Carrega a localização da RS e do ROB, para o CDB não precisar procurar a RS dona.
+    struct CompletionEvent {
+        RSGroup rsType;       // Grupo da RS de origem.
+        int rsIndex;          // Índice da RS dentro do grupo.
+        int robIndex;         // Entrada do ROB que recebe o resultado.
+        int instructionIndex; // Índice da instrução original.
+        int thread = 0;       // SMT: thread dona (fora do snapshot, que exige uma thread).
+
+        template <class Archive> void transfer(Archive &ar) { ar(rsType); ar(rsIndex); ar(robIndex); ar(instructionIndex); }
+    };
+    // Instruções atualmente nas unidades funcionais (já saíram da RS, mas ainda não
+    // enviaram resultado pelo CDB), organizadas como uma roda de tempo: o balde
+    // (ciclo % tamanho) guarda as instruções que terminam naquele ciclo, na ordem
+    // em que começaram. O tamanho da roda é maior que a maior latência, então baldes
+    // de ciclos diferentes nunca se misturam.
+    vector<vector<CompletionEvent>> executionWheel;
+    int executingCount = 0; // Quantidade de instruções na roda.
+
+    // Fila para instruções que finalizaram a execução e aguardam o CDB.
+    queue<CompletionEvent> completedForCDB;
+
+    // --- Estruturas de Wakeup/Select ---
+    // Uma RS que aguarda uma tag (Qj ou Qk) se registra na lista de consumidores
+    // da entrada do ROB correspondente. O broadcast no CDB visita apenas essa lista.
+    struct TagConsumer {
+        RSGroup group;  // Grupo da RS consumidora.
+        int slot;       // Índice da RS dentro do grupo.
+        bool isQk;      // true: aguarda em Qk; false: aguarda em Qj.
+
+        template <class Archive> void transfer(Archive &ar) { ar(group); ar(slot); ar(isQk); }
+    };
+    vector<vector<TagConsumer>> robConsumers; // Indexado pelo índice do ROB produtor.
+    // RSs com todos os operandos prontos que ainda não começaram a executar, por grupo.
+    // Cada RS entra aqui uma única vez: na emissão (se já pronta) ou no wakeup.
+    vector<int> readyRS[RS_GROUP_COUNT];
+
+    // --- Estatísticas ---
+    SimulatorStats stats;
+    int rsBusyCount[RS_GROUP_COUNT] = {}; // RSs ocupadas por grupo (mantido na emissão e no WriteResult).
+    // RSs livres por grupo, um bit por RS (1 = livre), mantido junto com 'busy': a busca por uma
+    // RS livre testa 64 RSs por palavra em vez de percorrer o grupo.
+    vector<uint64_t> freeRS[RS_GROUP_COUNT];
+
+    // --- Trace de eventos (opcional) ---
+    PipelineListener *listener = nullptr; // Quando definido, recebe um registro por evento do pipeline.
+    StageProfile *stageProfile = nullptr;  // Quando definido, acumula o tempo real de cada estágio.
+    chrono::steady_clock::time_point stageStart;
+
+    // --- Threads de hardware (SMT) ---
+    // Com smt.threads > 1, os membros acima com o estado de uma thread (programa, janela de busca,
+    // histórico, ROB e consumidores, registradores e status, memória, filas de LOAD/STORE e
+    // descartes pendentes) são os da thread ativa; os das demais ficam em 'threads', e
+    // selectThread() troca os dois lados (vetores e mapas trocados, sem cópia). RSs, unidades
+    // funcionais, roda de execução, CDB, caches, tabelas do preditor e estatísticas são
+    // compartilhados; cada RS e cada evento de execução levam a thread dona. Entre dois ciclos,
+    // a thread ativa é a 0.
+    struct ThreadContext {
+        const Program *activeProgram = nullptr; // nullptr: até o início, o mesmo programa da thread 0.
+        bool sourceExhausted = false;
+        int fetchPC = 0;
+        vector<InFlightInstruction> fetchWindow;
+        int fetchedCount = 0, committedCount = 0, nextInstructionIndex = 0;
+        vector<InFlightInstruction> history;
+        int historyStart = 0;
+        typename Shape::ReorderBuffer rob;
+        int robHead = 0, robTail = 0, robEntriesAvailable = 0;
+        vector<vector<TagConsumer>> robConsumers;
+        vector<Word> registers;
+        vector<RegisterStatus> regStatus;
+        SparseMemory memory;
+        deque<int> loadQueue, storeQueue;
+        int replayFrom = -1, mispredictedBranch = -1;
+        unsigned predictorHistory = 0; // Histórico global do preditor.
+
+        ThreadContext() : memory(0, MEMORY_FILL_IDENTITY) {}
+    };
+    struct SwapField { template <class T> void operator()(T &active, T &saved) const { using std::swap; swap(active, saved); } };
+    struct CopyField { template <class T> void operator()(T &active, T &saved) const { saved = active; } };
+    const SmtPolicy SMT_POLICY;
+    int activeThread = 0;
+    bool threadsStarted = false;           // As threads 1.. já buscaram a primeira instrução?
+    vector<ThreadContext> threads;         // Estado das threads inativas (vazio com uma thread).
+    deque<Program> threadPrograms;         // Programas próprios das threads 1.. (loadThreadInstructions).
+    vector<long long> threadCommitted;     // Instruções cometidas por thread (só com SMT).
+    vector<int> threadLastCommit;          // Ciclo do último commit de cada thread (-1: nenhum; só com SMT).
+    vector<int> threadBusyRS;              // RSs ocupadas por thread (ICOUNT).
+    vector<int> threadOrder;               // Ordem das threads no Issue deste ciclo.
+
+    // Aplica 'field' a cada membro do estado da thread ativa e ao campo correspondente de 'saved'.
+    template <class Field> void visitThreadState(ThreadContext &saved, Field field) {
+        field(activeProgram, saved.activeProgram); field(sourceExhausted, saved.sourceExhausted); field(fetchPC, saved.fetchPC);
+        field(fetchWindow, saved.fetchWindow); field(fetchedCount, saved.fetchedCount); field(committedCount, saved.committedCount);
+        field(nextInstructionIndex, saved.nextInstructionIndex); field(history, saved.history); field(historyStart, saved.historyStart);
+        field(rob, saved.rob); field(robHead, saved.robHead); field(robTail, saved.robTail);
+        field(robEntriesAvailable, saved.robEntriesAvailable); field(robConsumers, saved.robConsumers);
+        field(registers, saved.registers); field(regStatus, saved.regStatus); field(memory, saved.memory);
+        field(loadQueue, saved.loadQueue); field(storeQueue, saved.storeQueue);
+        field(replayFrom, saved.replayFrom); field(mispredictedBranch, saved.mispredictedBranch);
+    }
+
+    // Torna 'thread' a thread ativa. Com uma thread, não faz nada (e é chamada a cada evento).
+    void selectThread(int thread) { if (THREAD_COUNT > 1 && thread != activeThread) switchThread(thread); }
+    void switchThread(int thread) {
+        swapThreadState(threads[activeThread]); // Guarda a ativa no seu lugar (que estava vago)...
+        swapThreadState(threads[thread]);       // ...e traz a nova, deixando o lugar dela vago.
+        activeThread = thread;
+    }
+    void swapThreadState(ThreadContext &saved) {
+        visitThreadState(saved, SwapField());
+        unsigned history = predictor.getHistory();
+        predictor.setHistory(saved.predictorHistory);
+        saved.predictorHistory = history;
+    }
+
+    // Na primeira chamada de stepSimulation(): as threads sem programa próprio usam o da thread 0,
+    // e cada thread busca a sua primeira instrução.
+    void startThreads() {
+        threadsStarted = true;
+        const Program *mainProgram = activeProgram; // Antes do primeiro ciclo, a ativa é a 0.
+        for (int t = 1; t < THREAD_COUNT; ++t) {
+            if (!threads[t].activeProgram) threads[t].activeProgram = mainProgram;
+            selectThread(t);
+            fetchNextInstruction();
+        }
+        selectThread(0);
+    }
+
+    // A thread 'saved' (inativa) terminou? Mesmas condições de isSimulationComplete().
+    static bool threadFinished(const ThreadContext &saved, int robSize) {
+        return saved.activeProgram && saved.nextInstructionIndex >= saved.fetchedCount && saved.sourceExhausted &&
+               saved.robEntriesAvailable == robSize && saved.committedCount == saved.fetchedCount;
+    }
+
+    // Ordem das threads no Issue do ciclo 'atCycle': a partir de uma thread que avança a cada ciclo
+    // (round_robin) ou, com ICOUNT, da que tem menos RSs ocupadas (empates na mesma rotação).
+    void orderThreadsForIssue(int atCycle) {
+        threadOrder.resize(THREAD_COUNT);
+        for (int k = 0; k < THREAD_COUNT; ++k) threadOrder[k] = (atCycle + k) % THREAD_COUNT;
+        if (SMT_POLICY == SMT_ICOUNT) {
+            const vector<int> &busy = threadBusyRS;
+            stable_sort(threadOrder.begin(), threadOrder.end(), [&](int a, int b) { return busy[a] < busy[b]; });
+        }
+    }
+
+    string machineText; // Descrição da máquina (formato de --config), gravada no cabeçalho do snapshot.
+
+    // printf para a saída desta instância ('out').
+    void printFormatted(const char *format, ...) const {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (length < 0) return;
+        if (static_cast<size_t>(length) < sizeof(buffer)) { out->write(buffer, length); return; }
+        string text(length + 1, '\0'); // Linha maior que o buffer: formata de novo no tamanho certo.
+        va_start(args, format);
+        vsnprintf(&text[0], text.size(), format, args);
+        va_end(args);
+        out->write(text.data(), length);
+    }
+
+    // Instrução em voo (já buscada e não cometida) a partir do seu índice no programa.
+    InFlightInstruction &inFlight(int index) { return fetchWindow[index % FETCH_WINDOW_SIZE]; }
+    const InFlightInstruction &inFlight(int index) const { return fetchWindow[index % FETCH_WINDOW_SIZE]; }
+
+    // Lê a instrução em 'fetchPC' da fonte: o programa carregado ou, no modo streaming, a
+    // próxima linha do arquivo de texto (streaming só é usado em programas sem desvios).
+    bool readNextInstruction(DecodedInstruction &inst) {
+        if (!streaming) {
+            if (fetchPC >= static_cast<int>(activeProgram->size())) return false;
+            inst = (*activeProgram)[fetchPC];
+            return true;
+        }
+        while (getline(streamFile, streamLine)) {
+            if (Program::decodeLine(streamLine, inst, FP_REGISTER_COUNT, REGISTER_COUNT - FP_REGISTER_COUNT, *err)) return true;
+        }
+        return false;
+    }
+
+    // Traz a próxima instrução da fonte para a janela de busca. Chamada ao carregar o
+    // programa e a cada emissão, então a instrução seguinte está sempre disponível
+    // (ou 'sourceExhausted' já indica que o programa acabou). Depois de um desvio, a busca
+    // segue pela direção prevista; um salto (J) é seguido sempre.
+    void fetchNextInstruction() {
+        if (sourceExhausted || fetchedCount - committedCount >= FETCH_WINDOW_SIZE) return;
+        InFlightInstruction &slot = inFlight(fetchedCount);
+        if (!readNextInstruction(slot.decoded)) {
+            sourceExhausted = true;
+            if (streaming) streamFile.close();
+            return;
+        }
+        slot.timing = Instruction();
+        slot.pc = fetchPC;
+        slot.predictedTaken = slot.decoded.type() == JUMP;
+        if (slot.decoded.type() == BEQ || slot.decoded.type() == BNE) {
+            slot.historyBefore = predictor.getHistory();
+            slot.predictedTaken = predictor.predict(fetchPC, slot.decoded.imm);
+            predictor.speculate(slot.predictedTaken);
+        }
+        fetchPC = slot.predictedTaken ? slot.decoded.imm : fetchPC + 1;
+        fetchedCount++;
+    }
+
+    // Acesso a uma RS a partir do grupo e do índice.
+    ReservationStation &stationAt(RSGroup group, int slot) {
+        switch (group) {
+            case RS_ADD: return addRS[slot];
+            case RS_MUL: return mulRS[slot];
+            case RS_LOAD: return loadRS[slot];
+            case RS_STORE: return storeRS[slot];
+            case RS_FPADD: return fpAddRS[slot];
+            default: return fpMulRS[slot];
+        }
+    }
+
+    void markRSBusy(RSGroup group, int slot) { freeRS[group][slot >> 6] &= ~(uint64_t(1) << (slot & 63)); }
+    void markRSFree(RSGroup group, int slot) { freeRS[group][slot >> 6] |= uint64_t(1) << (slot & 63); }
+
+    // Reconstrói os bits de RSs livres a partir de 'busy' (na construção e ao restaurar um snapshot).
+    void rebuildFreeRS() {
+        for (int g = 0; g < RS_GROUP_COUNT; ++g) {
+            RSGroup group = static_cast<RSGroup>(g);
+            freeRS[g].assign((groupSize(group) + 63) / 64, 0);
+            for (int slot = 0; slot < groupSize(group); ++slot) if (!stationAt(group, slot).busy) markRSFree(group, slot);
+        }
+    }
+
+    // rename = prf: sem instruções em voo, cada registrador arquitetural é o físico de mesmo
+    // número (com o valor de 'registers') e os demais físicos estão na lista livre.
+    void resetPhysicalRegisters() {
+        if (RENAME_MODE != RENAME_PRF) return;
+        renameMap.resize(REGISTER_COUNT);
+        physicalValues.assign(PHYSICAL_REGISTER_COUNT, 0);
+        physicalReady.assign(PHYSICAL_REGISTER_COUNT, 1);
+        physicalProducer.assign(PHYSICAL_REGISTER_COUNT, -1);
+        freePhysical.clear();
+        for (int reg = 0; reg < REGISTER_COUNT; ++reg) { renameMap[reg] = reg; physicalValues[reg] = registers[reg]; }
+        for (int phys = REGISTER_COUNT; phys < PHYSICAL_REGISTER_COUNT; ++phys) freePhysical.push_back(phys);
+    }
+
+    // Operandos da RS: com rename = prf, lidos do registrador físico; senão, os valores copiados.
+    Word operandJ(const ReservationStation &rs) const { return rs.Pj >= 0 ? physicalValues[rs.Pj] : rs.Vj; }
+    Word operandK(const ReservationStation &rs) const { return rs.Pk >= 0 ? physicalValues[rs.Pk] : rs.Vk; }
+
+    // Resultado de uma entrada do ROB (no registrador físico, com rename = prf).
+    Word entryResult(const ReorderBufferEntry &entry) const {
+        return entry.physicalRegister >= 0 ? physicalValues[entry.physicalRegister] : entry.value;
+    }
+
+    // Busca uma Estação de Reserva (RS) livre para o tipo de instrução especificado: a de
+    // menor índice do grupo. Retorna o índice da RS e o grupo de RS correspondente.
+    pair<int, RSGroup> findFreeRS(InstructionType type) {
+        RSGroup group;
+        if (type == ADD || type == SUB || type == BEQ || type == BNE || usesImmediate(type)) group = RS_ADD; // Somas, subtrações e desvios usam as mesmas RSs.
+        else if (type == MUL || type == DIV) group = RS_MUL; // Multiplicações e divisões também.
+        else if (type == ADD_D || type == SUB_D || isConversion(type)) group = RS_FPADD;
+        else if (type == MUL_D || type == DIV_D) group = RS_FPMUL;
+        else if (type == LOAD) group = RS_LOAD;
+        else if (type == STORE) group = RS_STORE;
+        else return {-1, RS_NONE};
+        const vector<uint64_t> &free = freeRS[group];
+        for (size_t w = 0; w < free.size(); ++w) {
+            if (free[w]) return {static_cast<int>(w * 64) + lowestSetBit(free[w]), group};
+        }
+        return {-1, RS_NONE}; // Sinaliza que nenhuma RS do tipo está livre.
+    }
+
+    // Lógica do estágio de Emissão (Issue).
+    // Tenta alocar recursos (ROB, RS) e buscar operandos para a próxima instrução.
+    bool issueInstruction() {
+        // Condições para não emitir: sem instruções pendentes ou ROB cheio.
+        if (nextInstructionIndex >= fetchedCount || robEntriesAvailable == 0) {
+            return false; // Não há o que ou onde emitir.
+        }
+        InFlightInstruction &fetched = inFlight(nextInstructionIndex);
+        const DecodedInstruction &decoded = fetched.decoded; // Instrução a ser emitida.
+        Instruction &originalInst = fetched.timing;         // Seu registro de timing.
+        // Registradores como índices no banco (os R depois dos F); -1 para "não usado".
+        const int src1Reg = registerIndex(decoded.src1, FP_REGISTER_COUNT);
+        const int src2Reg = registerIndex(decoded.src2, FP_REGISTER_COUNT);
+        const int destReg = registerIndex(decoded.dest, FP_REGISTER_COUNT);
+        // rename = prf: o destino precisa de um registrador físico livre.
+        if (RENAME_MODE == RENAME_PRF && destReg >= 0 && freePhysical.empty()) return false;
+
+        // Verifica disponibilidade de RS. O salto (J) não precisa de RS: já foi seguido na busca.
+        pair<int, RSGroup> rsInfo(-1, RS_NONE);
+        if (decoded.type() != JUMP) {
+            rsInfo = findFreeRS(decoded.type());
+            if (rsInfo.first == -1) {
+                return false; // Emperramento estrutural: nenhuma RS livre para este tipo de instrução.
+            }
+            rsBusyCount[rsInfo.second]++;
+            markRSBusy(rsInfo.second, rsInfo.first);
+            if (THREAD_COUNT > 1) threadBusyRS[activeThread]++;
+        }
+
+        // Passo 1: Alocar entrada no ROB.
+        int currentRobIdx = robTail; // Pega a próxima posição livre na cauda do ROB.
+        ReorderBufferEntry &robEntry = rob[currentRobIdx];
+        robEntry.busy = true;
+        robEntry.instructionIndex = nextInstructionIndex;
+        robEntry.type = decoded.type();
+        robEntry.state = ROB_ISSUE; // Estado inicial da instrução no ROB.
+        // STORE e desvios não têm registrador de destino arquitetural (dest = NO_REGISTER).
+        robEntry.destinationRegister = destReg;
+        robEntry.value = 0; // Inicializa valor.
+        robEntry.address = 0; // Inicializa endereço.
+        robEntry.valueReady = false; // Valor ainda não está pronto.
+        robEntry.addressReady = false;
+        robEntry.memoryAccessed = false;
+        robEntry.forwardedFrom = -1;
+        robEntry.physicalRegister = robEntry.previousPhysical = -1;
+        if (decoded.type() == LOAD) loadQueue.push_back(currentRobIdx);
+        else if (decoded.type() == STORE) storeQueue.push_back(currentRobIdx);
+
+        robTail = robTail + 1 == ROB_SIZE ? 0 : robTail + 1; // Avança a cauda do ROB (circular, sem divisão).
+        robEntriesAvailable--;
+        originalInst.issue = cycle; // Marca o ciclo de emissão na instrução original.
+
+        if (decoded.type() == JUMP) { // Sem execução: fica pronto para o commit.
+            robEntry.state = ROB_WRITERESULT;
+            robEntry.value = 1;
+            robEntry.valueReady = true;
+            originalInst.execComp = originalInst.writeResult = cycle;
+            if (listener) {
+                TraceRecord record;
+                record.cycle = cycle; record.event = TRACE_ISSUE;
+                record.instructionIndex = nextInstructionIndex; record.op = JUMP; record.robIndex = currentRobIdx;
+                record.decoded = &decoded; record.pc = fetched.pc;
+                listener->onEvent(record);
+            }
+            nextInstructionIndex++;
+            fetchNextInstruction();
+            return true;
+        }
+
+        // Passo 2: Preencher a Estação de Reserva (RS) que foi alocada.
+        ReservationStation *rs = &stationAt(rsInfo.second, rsInfo.first); // Ponteiro para a RS específica.
+
+        rs->busy = true;
+        rs->op = decoded.type();
+        rs->instructionIndex = nextInstructionIndex;
+        rs->thread = activeThread;
+        // A RS precisa saber para qual entrada do ROB ela deve enviar seu resultado.
+        rs->destRobIndex = currentRobIdx;
+        rs->Pj = rs->Pk = -1;
+
+        // Passo 3: Obter operandos (Vj, Vk) ou as tags de dependência (Qj, Qk) para a RS.
+        // Tratamento do primeiro operando (src1 -> Vj/Qj).
+        if (decoded.type() == LOAD) { // Para LOAD, src1 é o offset, vai para o campo 'A'.
+            rs->A = decoded.imm;
+            rs->Vj = 0; rs->Qj = TAG_READY; // Vj/Qj não são usados para registrador em LOAD desta forma.
+        } else { // Aritméticas e desvios (src1 é um registrador) e STORE (src1 é o registrador do dado).
+            if (src1Reg >= 0 && RENAME_MODE == RENAME_PRF) {
+                rs->Qj = renameSource(src1Reg, rs->Pj, rsInfo, false);
+            } else if (src1Reg >= 0) { // src1 existe?
+                const RegisterStatus &src1Status = regStatus[src1Reg];
+                if (src1Status.busy) { // Valor de src1 está pendente?
+                    int producingRobIdx = src1Status.robIndex;
+                    // O valor já pode estar pronto no ROB, mesmo que o commit não tenha ocorrido.
+                    // Isso permite pegar o valor adiantado (forwarding).
+                    if (rob[producingRobIdx].busy && rob[producingRobIdx].state == ROB_WRITERESULT && rob[producingRobIdx].valueReady) {
+                        rs->Vj = rob[producingRobIdx].value; // Pega valor direto do ROB.
+                        rs->Qj = TAG_READY; // Marca como disponível.
+                    } else {
+                        rs->Qj = producingRobIdx; // Ainda não pronto, armazena a tag do ROB.
+                        robConsumers[producingRobIdx].push_back({rsInfo.second, rsInfo.first, false});
+                    }
+                } else { // Valor de src1 está no banco de registradores.
+                    rs->Vj = registers[src1Reg];
+                    rs->Qj = TAG_READY; // Marca como disponível.
+                }
+            } else { rs->Vj = 0; rs->Qj = TAG_READY;} // Caso não haja src1 (raro, depende da arquitetura).
+        }
+
+        // Tratamento do segundo operando (src2 -> Vk/Qk).
+        // Aplica-se a Arith e desvios (src2 é registrador) e Load/Store (src2 é registrador base);
+        // em ADDI/SUBI, Vk é o imediato.
+        if (usesImmediate(decoded.type())) {
+            rs->Vk = decoded.imm;
+            rs->Qk = TAG_READY;
+        } else if (!isConversion(decoded.type())) { // Instruções que podem usar src2.
+            if (src2Reg >= 0 && RENAME_MODE == RENAME_PRF) {
+                rs->Qk = renameSource(src2Reg, rs->Pk, rsInfo, true);
+            } else if (src2Reg >= 0) { // src2 existe?
+                const RegisterStatus &src2Status = regStatus[src2Reg];
+                if (src2Status.busy) { // Valor de src2 pendente?
+                    int producingRobIdx = src2Status.robIndex;
+                    if (rob[producingRobIdx].busy && rob[producingRobIdx].state == ROB_WRITERESULT && rob[producingRobIdx].valueReady) {
+                        rs->Vk = rob[producingRobIdx].value; // Pega valor direto do ROB.
+                        rs->Qk = TAG_READY; // Marca como disponível.
+                    } else {
+                        rs->Qk = producingRobIdx; // Ainda não pronto, armazena tag.
+                        robConsumers[producingRobIdx].push_back({rsInfo.second, rsInfo.first, true});
+                    }
+                } else { // Valor de src2 no banco de registradores.
+                    rs->Vk = registers[src2Reg];
+                    rs->Qk = TAG_READY; // Marca como disponível.
+                }
+            } else { // Sem src2 explícito (ex: L.D F1, 100() poderia implicar base R0 ou ser um erro de formato).
+                     // Neste simulador, assume-se 0 se src2 estiver vazio.
+                rs->Vk = 0;
+                rs->Qk = TAG_READY;
+            }
+        } else {rs->Vk = 0; rs->Qk = TAG_READY;} // CVT: não usa um segundo operando.
+
+        // Lógica específica para STORE durante o Issue.
+        if (decoded.type() == STORE) {
+            rs->A = decoded.imm; // Offset do endereço (offset(base)).
+            // Se o valor a ser armazenado (Vj, vindo de inst.src1) já estiver disponível na RS,
+            // o campo 'value' e 'valueReady' na entrada do ROB do STORE pode ser preenchido.
+            if (rs->Qj == TAG_READY) { // Vj (dado do store) está pronto?
+                rob[currentRobIdx].value = operandJ(*rs); // 'value' no ROB do STORE é o dado a ser escrito.
+                rob[currentRobIdx].valueReady = true;
+            }
+        }
+        // Com a base já disponível, o endereço do LOAD/STORE é calculado na emissão.
+        if ((decoded.type() == LOAD || decoded.type() == STORE) && MEMORY_ORDER != MEMORY_ORDER_NONE && rs->Qk == TAG_READY) {
+            resolveAddress(*rs);
+        }
+
+        // Passo 4: Atualizar a Tabela de Status do Registrador de Destino (Renomeação).
+        // Se a instrução modifica um registrador (ou seja, não é STORE nem desvio),
+        // marca esse registrador como 'busy' e aponta para a entrada do ROB que calculará seu novo valor.
+        // Com rename = prf, o destino recebe um registrador físico da lista livre.
+        if (robEntry.destinationRegister >= 0 && RENAME_MODE == RENAME_PRF) {
+            int phys = freePhysical.front();
+            freePhysical.pop_front();
+            robEntry.physicalRegister = phys;
+            robEntry.previousPhysical = renameMap[destReg];
+            renameMap[destReg] = phys;
+            physicalReady[phys] = 0;
+            physicalProducer[phys] = currentRobIdx;
+        } else if (robEntry.destinationRegister >= 0) {
+            regStatus[destReg].busy = true;
+            regStatus[destReg].robIndex = currentRobIdx;
+        }
+
+        // Com os operandos já disponíveis, a RS é candidata à execução neste mesmo ciclo.
+        if (rs->Qj == TAG_READY && rs->Qk == TAG_READY) {
+            readyRS[rsInfo.second].push_back(rsInfo.first);
+            stats.operandWait.add(0);
+        }
+
+        if (listener) {
+            TraceRecord record;
+            record.cycle = cycle; record.event = TRACE_ISSUE;
+            record.instructionIndex = nextInstructionIndex; record.op = decoded.type(); record.robIndex = currentRobIdx;
+            record.rsGroup = rsInfo.second; record.rsSlot = rsInfo.first;
+            record.hasTags = true; record.qj = rs->Qj; record.qk = rs->Qk;
+            record.decoded = &decoded; record.pc = fetched.pc;
+            listener->onEvent(record);
+        }
+
+        nextInstructionIndex++; // Avança para a próxima instrução do programa.
+        fetchNextInstruction(); // Deixa a próxima instrução pronta na janela de busca.
+        return true; // Emissão bem-sucedida.
+    }
+
+    // rename = prf: operando-fonte 'reg' da RS 'slot' (índice e grupo). 'phys' recebe o registrador físico mapeado;
+    // se ele ainda não foi escrito, a RS se registra como consumidora do produtor e a tag
+    // retornada é a entrada do ROB dele. Nenhum valor é copiado: a execução lê o físico.
+    int renameSource(int reg, int &phys, pair<int, RSGroup> slot, bool isQk) {
+        phys = renameMap[reg];
+        if (physicalReady[phys]) return TAG_READY;
+        int producingRobIdx = physicalProducer[phys];
+        robConsumers[producingRobIdx].push_back({slot.second, slot.first, isQk});
+        return producingRobIdx;
+    }
+
+    // Calcula o endereço efetivo de um LOAD/STORE assim que a base (Vk) fica pronta, sem esperar a
+    // execução. Um STORE que descobre o seu endereço verifica se algum LOAD mais novo já leu dele.
+    void resolveAddress(const ReservationStation &rs) {
+        ReorderBufferEntry &entry = rob[rs.destRobIndex];
+        entry.address = effectiveAddress(rs.A, operandK(rs));
+        entry.addressReady = true;
+        if (rs.op == STORE && MEMORY_ORDER == MEMORY_ORDER_SPECULATIVE) checkMemoryViolation(entry);
+    }
+
+    // Um LOAD mais novo que 'store', no mesmo endereço, que leu o valor antes deste STORE ter
+    // endereço conhecido (da memória ou de um STORE mais antigo) leu um valor errado: ele e as
+    // instruções seguintes são reexecutados ao fim do WriteResult.
+    void checkMemoryViolation(const ReorderBufferEntry &store) {
+        for (size_t i = 0; i < loadQueue.size(); ++i) { // Em ordem de programa: o primeiro encontrado é o mais antigo.
+            const ReorderBufferEntry &load = rob[loadQueue[i]];
+            if (load.instructionIndex < store.instructionIndex || !load.memoryAccessed || load.address != store.address) continue;
+            if (load.forwardedFrom > store.instructionIndex) continue; // Valor de um STORE mais novo que este: correto.
+            if (replayFrom < 0 || load.instructionIndex < replayFrom) replayFrom = load.instructionIndex;
+            return;
+        }
+    }
+
+    // Verifica um LOAD contra os STOREs mais antigos em voo, do mais novo para o mais antigo.
+    // Retorna false se o LOAD precisa esperar: um STORE no mesmo endereço ainda sem o dado ou,
+    // no modo conservador, um STORE com endereço desconhecido. Senão, 'source' é o índice do ROB
+    // do STORE que fornece o valor (-1: a memória) e 'speculative' diz se o LOAD passa à frente
+    // de algum STORE com endereço desconhecido.
+    bool checkOlderStores(int loadInstructionIndex, int address, int &source, bool &speculative) const {
+        source = -1;
+        speculative = false;
+        for (size_t i = storeQueue.size(); i-- > 0;) {
+            const ReorderBufferEntry &store = rob[storeQueue[i]];
+            if (store.instructionIndex > loadInstructionIndex) continue; // STORE mais novo que o LOAD.
+            if (!store.addressReady) {
+                if (MEMORY_ORDER == MEMORY_ORDER_CONSERVATIVE) return false;
+                speculative = true;
+                continue;
+            }
+            if (store.address != address) continue;
+            if (!store.valueReady) return false; // Mesmo endereço: o dado será encaminhado quando chegar.
+            source = storeQueue[i];
+            return true;
+        }
+        return true;
+    }
+
+    // Endereço do LOAD/STORE que passa pelos caches, ou -1 se o acesso não usa os caches
+    // (caches desligados, endereço inválido ou LOAD com o valor encaminhado de um STORE).
+    int cachedAddress(const ReservationStation &rs, bool forwarded) const {
+        if (!caches.enabled() || (rs.op != LOAD && rs.op != STORE) || forwarded) return -1;
+        int address = effectiveAddress(rs.A, operandK(rs));
+        // Com SMT, cada thread tem a sua memória: os endereços das threads não se confundem nos caches.
+        return memory.contains(address) ? address + activeThread * MEMORY_SIZE : -1;
+    }
+
+    // Por que uma RS pronta não começa a executar neste ciclo (mesmas verificações, e na mesma
+    // ordem, de startExecution()). Em READY_WAIT_MSHR, 'blockedLevel' é o nível de cache sem MSHR.
+    enum ReadyBlock { READY_CAN_START, READY_WAIT_STORE, READY_WAIT_UNIT, READY_WAIT_MSHR };
+    ReadyBlock readyBlockCause(const ReservationStation &rs, int &blockedLevel) const {
+        int source = -1;
+        bool speculative;
+        if (rs.op == LOAD && MEMORY_ORDER != MEMORY_ORDER_NONE && !checkOlderStores(rs.instructionIndex, effectiveAddress(rs.A, operandK(rs)), source, speculative)) {
+            return READY_WAIT_STORE; // Só um WriteResult libera o LOAD.
+        }
+        if (findFreeUnit(fuPools[functionalUnitFor(rs.op)]) < 0) return READY_WAIT_UNIT;
+        int address = cachedAddress(rs, source >= 0);
+        if (address >= 0 && (blockedLevel = caches.blockingLevel(address, cycle)) >= 0) return READY_WAIT_MSHR;
+        return READY_CAN_START;
+    }
+
+    // Quantidade de RSs de um grupo.
+    int groupSize(RSGroup group) const {
+        switch (group) {
+            case RS_ADD: return ADD_RS_COUNT;
+            case RS_MUL: return MUL_RS_COUNT;
+            case RS_LOAD: return LOAD_RS_COUNT;
+            case RS_STORE: return STORE_RS_COUNT;
+            case RS_FPADD: return FPADD_RS_COUNT;
+            default: return FPMUL_RS_COUNT;
+        }
+    }
+
+    // Descarta a instrução 'firstSquashed' e todas as mais novas. Elas continuam na janela de
+    // busca e são emitidas de novo; entradas do ROB, RSs, eventos de execução e a renomeação
+    // dos registradores são desfeitos. Retorna quantas instruções emitidas foram descartadas.
+    int squashFrom(int firstSquashed) {
+        int squashedCount = 0;
+        while (!loadQueue.empty() && rob[loadQueue.back()].instructionIndex >= firstSquashed) loadQueue.pop_back();
+        while (!storeQueue.empty() && rob[storeQueue.back()].instructionIndex >= firstSquashed) storeQueue.pop_back();
+
+        // Entradas do ROB, da cauda para a cabeça.
+        while (robEntriesAvailable < ROB_SIZE) {
+            int last = robTail == 0 ? ROB_SIZE - 1 : robTail - 1;
+            ReorderBufferEntry &entry = rob[last];
+            if (entry.instructionIndex < firstSquashed) break;
+            if (listener) {
+                TraceRecord record;
+                record.cycle = cycle; record.event = TRACE_SQUASH;
+                record.instructionIndex = entry.instructionIndex; record.op = entry.type; record.robIndex = last;
+                listener->onEvent(record);
+            }
+            inFlight(entry.instructionIndex).timing = Instruction();
+            // rename = prf: desfaz o mapeamento do destino (do mais novo para o mais antigo)
+            // e devolve o físico à frente da lista livre, na ordem em que tinha sido alocado.
+            if (entry.physicalRegister >= 0) {
+                renameMap[entry.destinationRegister] = entry.previousPhysical;
+                physicalReady[entry.physicalRegister] = 1;
+                physicalProducer[entry.physicalRegister] = -1;
+                freePhysical.push_front(entry.physicalRegister);
+            }
+            entry = ReorderBufferEntry();
+            robConsumers[last].clear();
+            robTail = last;
+            robEntriesAvailable++;
+            squashedCount++;
+        }
+
+        // RSs das instruções descartadas, e as referências a elas nas listas de prontas e de consumidores.
+        for (int g = 0; g < RS_GROUP_COUNT; ++g) {
+            RSGroup group = static_cast<RSGroup>(g);
+            for (int slot = 0; slot < groupSize(group); ++slot) {
+                ReservationStation &station = stationAt(group, slot);
+                if (!station.busy || station.thread != activeThread || station.instructionIndex < firstSquashed) continue;
+                station = ReservationStation();
+                rsBusyCount[g]--;
+                markRSFree(group, slot);
+                if (THREAD_COUNT > 1) threadBusyRS[activeThread]--;
+            }
+            vector<int> &ready = readyRS[g];
+            ready.erase(remove_if(ready.begin(), ready.end(), [&](int slot) { return !stationAt(group, slot).busy; }), ready.end());
+        }
+        for (int r = 0; r < ROB_SIZE; ++r) {
+            vector<TagConsumer> &consumers = robConsumers[r];
+            consumers.erase(remove_if(consumers.begin(), consumers.end(),
+                [&](const TagConsumer &c) { return !stationAt(c.group, c.slot).busy; }), consumers.end());
+        }
+
+        // Instruções descartadas nas unidades funcionais e na fila do CDB.
+        auto squashed = [&](const CompletionEvent &event) { return event.thread == activeThread && event.instructionIndex >= firstSquashed; };
+        for (int b = 0; b < WHEEL_SIZE; ++b) {
+            vector<CompletionEvent> &bucket = executionWheel[b];
+            size_t before = bucket.size();
+            bucket.erase(remove_if(bucket.begin(), bucket.end(), squashed), bucket.end());
+            executingCount -= static_cast<int>(before - bucket.size());
+        }
+        queue<CompletionEvent> remaining;
+        for (; !completedForCDB.empty(); completedForCDB.pop()) {
+            if (!squashed(completedForCDB.front())) remaining.push(completedForCDB.front());
+        }
+        completedForCDB.swap(remaining);
+
+        // Renomeação: o último produtor de cada registrador entre as instruções que ficaram.
+        for (int reg = 0; reg < REGISTER_COUNT; ++reg) regStatus[reg] = RegisterStatus();
+        for (int i = 0, idx = robHead; i < ROB_SIZE - robEntriesAvailable; ++i, idx = idx + 1 == ROB_SIZE ? 0 : idx + 1) {
+            if (rob[idx].destinationRegister < 0 || rob[idx].physicalRegister >= 0) continue; // STORE, desvio ou rename = prf.
+            regStatus[rob[idx].destinationRegister].busy = true;
+            regStatus[rob[idx].destinationRegister].robIndex = idx;
+        }
+
+        nextInstructionIndex = firstSquashed; // A emissão recomeça pela instrução descartada mais antiga.
+        return squashedCount;
+    }
+
+    // Desvio 'branch' resolvido com a direção mal prevista: as instruções seguintes (o caminho
+    // errado) saem do ROB e da janela de busca, e a busca recomeça no alvo correto.
+    void recoverFromMisprediction(int branch) {
+        stats.wrongPathInstructions += squashFrom(branch + 1);
+        const InFlightInstruction &fetched = inFlight(branch);
+        bool taken = !fetched.predictedTaken;
+        predictor.recover(fetched.historyBefore, taken);
+        fetchedCount = branch + 1;
+        fetchPC = taken ? fetched.decoded.imm : fetched.pc + 1;
+        sourceExhausted = false;
+        fetchNextInstruction();
+    }
+
+    // Latência de execução de cada tipo de instrução.
+    int latencyOf(InstructionType type) const {
+        switch (type) {
+            case ADD: case SUB: case ADDI: case SUBI: return ADD_LATENCY;
+            case MUL: return MUL_LATENCY;
+            case DIV: return DIV_LATENCY;
+            case LOAD: return LOAD_LATENCY;
+            case STORE: return STORE_LATENCY;
+            case ADD_D: case SUB_D: case CVT_D_W: case CVT_W_D: return FP_ADD_LATENCY;
+            case MUL_D: return FP_MUL_LATENCY;
+            case DIV_D: return FP_DIV_LATENCY;
+            default: return 1;
+        }
+    }
+
+    // Procura uma unidade do conjunto capaz de aceitar uma operação neste ciclo. Retorna -1 se todas estão ocupadas.
+    int findFreeUnit(const FunctionalUnitPool &pool) const {
+        for (size_t u = 0; u < pool.nextFreeCycle.size(); ++u) if (pool.nextFreeCycle[u] <= cycle) return static_cast<int>(u);
+        return -1;
+    }
+
+    // Dispara a execução das RSs que ficaram prontas (Qj e Qk iguais a TAG_READY).
+    // Apenas as RSs das listas readyRS são visitadas. Cada RS pronta precisa ainda de uma unidade
+    // funcional livre do seu tipo; sem unidade (hazard estrutural), ela continua na lista e tenta no próximo ciclo.
+    void startExecution() {
+        for (int type_idx = 0; type_idx < RS_GROUP_COUNT; ++type_idx) { // Itera sobre os grupos de RS (ADD, MUL, LOAD, STORE).
+            RSGroup group = static_cast<RSGroup>(type_idx);
+            vector<int> &ready = readyRS[type_idx];
+            if (ready.empty()) continue;
+            // Seleção em ordem de índice da RS dentro do grupo (prioridade fixa).
+            sort(ready.begin(), ready.end());
+
+            size_t waiting = 0; // RSs prontas que ficaram sem unidade funcional são compactadas no início da lista.
+            for (size_t k = 0; k < ready.size(); ++k) {
+                int slot = ready[k];
+                ReservationStation &currentRS = stationAt(group, slot);
+                selectThread(currentRS.thread); // ROB, janela de busca e filas de LOAD/STORE da thread dona.
+
+                // O LOAD só acessa a memória depois de verificado contra os STOREs mais antigos.
+                int storeSource = -1;
+                bool speculativeLoad = false;
+                if (currentRS.op == LOAD && MEMORY_ORDER != MEMORY_ORDER_NONE &&
+                    !checkOlderStores(currentRS.instructionIndex, effectiveAddress(currentRS.A, operandK(currentRS)), storeSource, speculativeLoad)) {
+                    stats.memoryWaitCycles++;
+                    ready[waiting++] = slot;
+                    continue;
+                }
+
+                // Reserva uma unidade funcional do tipo da operação.
+                FunctionalUnitPool &pool = fuPools[functionalUnitFor(currentRS.op)];
+                int latency = latencyOf(currentRS.op); // MUL e DIV compartilham RSs, mas têm latências diferentes.
+                int unit = findFreeUnit(pool);
+                if (unit < 0) {
+                    pool.stallCycles++; // Operandos prontos, mas nenhuma unidade livre neste ciclo.
+                    ready[waiting++] = slot;
+                    continue;
+                }
+                // Com caches, a latência do LOAD/STORE depende de acerto ou falta. Uma falta sem
+                // MSHR livre não começa: a RS continua pronta e tenta no próximo ciclo.
+                if (caches.enabled() && (currentRS.op == LOAD || currentRS.op == STORE)) {
+                    int address = cachedAddress(currentRS, storeSource >= 0);
+                    int blockedLevel = address >= 0 ? caches.blockingLevel(address, cycle) : -1;
+                    if (blockedLevel >= 0) {
+                        caches.recordMshrStall(blockedLevel, 1);
+                        ready[waiting++] = slot;
+                        continue;
+                    }
+                    latency = address >= 0 ? caches.access(address, cycle) : caches.hitLatency();
+                }
+                // Unidade pipelined aceita outra operação após 'issueInterval' ciclos;
+                // unidade não pipelined fica ocupada durante toda a latência.
+                pool.nextFreeCycle[unit] = cycle + (pool.pipelined ? pool.issueInterval : max(latency, 1));
+                pool.operations++;
+
+                int robIdxForInst = currentRS.destRobIndex; // Obtém o índice do ROB associado.
+                // Atualiza o estado da instrução no ROB para EXECUTE.
+                // É importante verificar se a entrada do ROB ainda é relevante (busy e no estado ISSUE).
+                if(rob[robIdxForInst].busy && rob[robIdxForInst].state == ROB_ISSUE) {
+                    rob[robIdxForInst].state = ROB_EXECUTE;
+                }
+
+                CompletionEvent exec; // Prepara para adicionar à roda de execução.
+                exec.rsType = group;
+                exec.rsIndex = slot;
+                exec.robIndex = robIdxForInst;
+                exec.instructionIndex = currentRS.instructionIndex;
+                exec.thread = activeThread;
+
+                // O primeiro ciclo de execução é o próprio ciclo de início, então a
+                // conclusão ocorre em cycle + latency - 1 (no mínimo, no ciclo atual).
+                int completionCycle = cycle + max(latency, 1) - 1;
+                executionWheel[completionCycle % WHEEL_SIZE].push_back(exec);
+                executingCount++;
+
+                if (listener) {
+                    TraceRecord record;
+                    record.cycle = cycle; record.event = TRACE_EXEC_START;
+                    record.instructionIndex = currentRS.instructionIndex; record.op = currentRS.op; record.robIndex = robIdxForInst;
+                    record.rsGroup = group; record.rsSlot = slot; record.unit = unit;
+                    listener->onEvent(record);
+                }
+
+                // Caso especial para STORE: se o valor (Vj) ficou pronto (Qj resolvido)
+                // e a instrução está começando a execução (Qk também resolvido),
+                // o valor do dado do STORE deve ser atualizado na entrada do ROB.
+                if (currentRS.op == STORE && rob[robIdxForInst].busy && !rob[robIdxForInst].valueReady) {
+                    rob[robIdxForInst].value = operandJ(currentRS); // Vj deve estar pronto neste ponto.
+                    rob[robIdxForInst].valueReady = true;
+                }
+
+                // LOAD: lê o valor agora, de um STORE em voo (encaminhamento) ou da memória.
+                // O valor fica na entrada do ROB e é transmitido no WriteResult.
+                if (currentRS.op == LOAD && MEMORY_ORDER != MEMORY_ORDER_NONE) {
+                    ReorderBufferEntry &load = rob[robIdxForInst];
+                    load.address = effectiveAddress(currentRS.A, operandK(currentRS));
+                    load.addressReady = true;
+                    load.memoryAccessed = true;
+                    if (storeSource >= 0) {
+                        load.value = rob[storeSource].value;
+                        load.forwardedFrom = rob[storeSource].instructionIndex;
+                        stats.forwardedLoads++;
+                    } else {
+                        load.value = memory.contains(load.address) ? memory.read(load.address) : 0;
+                        load.forwardedFrom = -1;
+                    }
+                    if (speculativeLoad) stats.speculativeLoads++;
+                }
+            }
+            ready.resize(waiting);
+        }
+    }
+
+    // Simula o avanço de um ciclo para as instruções que estão nas unidades funcionais.
+    // Apenas o balde do ciclo atual é visitado: são as instruções que terminam agora.
+    void advanceExecution() {
+        vector<CompletionEvent> &finishing = executionWheel[cycle % WHEEL_SIZE];
+        for (size_t i = 0; i < finishing.size(); ++i) {
+            selectThread(finishing[i].thread);
+            // Registra o ciclo de conclusão da execução na instrução original.
+            inFlight(finishing[i].instructionIndex).timing.execComp = cycle;
+            // Adiciona à fila do CDB para escrita no ROB no próximo ciclo.
+            completedForCDB.push(finishing[i]);
+            if (listener) {
+                TraceRecord record;
+                record.cycle = cycle; record.event = TRACE_EXEC_COMPLETE;
+                record.instructionIndex = finishing[i].instructionIndex;
+                record.op = inFlight(finishing[i].instructionIndex).decoded.type(); record.robIndex = finishing[i].robIndex;
+                listener->onEvent(record);
+            }
+        }
+        executingCount -= static_cast<int>(finishing.size());
+        finishing.clear(); // Mantém a capacidade do balde para reutilização.
+    }
+
+    // Processa os resultados que chegam pelo Common Data Bus (CDB).
+    // Escreve o resultado na entrada do ROB e encaminha para RSs dependentes.
+    // Retorna true se um resultado ocupou o CDB neste ciclo.
+    bool processWriteBack() {
+        if (completedForCDB.empty()) return false; // Fila do CDB vazia, nada a fazer.
+
+        CompletionEvent event = completedForCDB.front(); // Pega a próxima instrução da fila.
+        completedForCDB.pop(); // Remove da fila.
+        selectThread(event.thread);
+        int originalInstIndex = event.instructionIndex;
+
+        InFlightInstruction &fetched = inFlight(originalInstIndex);
+        Instruction &inst = fetched.timing; // Timing da instrução original.
+        // Registra o ciclo em que o resultado é escrito no ROB.
+        inst.writeResult = cycle;
+
+        // O evento aponta diretamente para a RS que processou esta instrução
+        // (de onde vêm Vj, Vk e A) e para a entrada do ROB de destino.
+        ReservationStation *rs = &stationAt(event.rsType, event.rsIndex);
+        if (!rs->busy || rs->instructionIndex != originalInstIndex) {
+            // A RS não pertence mais a esta instrução: estado inesperado (não deveria ocorrer,
+            // já que uma RS só é liberada pelo seu próprio WriteBack).
+            return true; // Não pode prosseguir sem a RS (o evento consumiu o CDB mesmo assim).
+        }
+        int producingRobIdx = event.robIndex; // Índice do ROB de destino.
+
+        Word resultData = 0;     // Para resultados de ALU e dados de LOAD.
+        int effectiveAddr = 0;   // Para o endereço calculado em LOAD/STORE.
+
+        // Calcula o resultado ou endereço efetivo, com base no tipo da instrução.
+        // Os valores Vj, Vk, A são lidos da RS onde a instrução estava aguardando.
+        // Com rename = prf, os operandos são lidos agora dos registradores físicos.
+        Word Vj = operandJ(*rs), Vk = operandK(*rs);
+        switch (fetched.decoded.type()) {
+            case ADD: case SUB: case MUL: case ADDI: case SUBI: // ADDI/SUBI: o imediato está em Vk.
+            case ADD_D: case SUB_D: case MUL_D: case DIV_D: case CVT_D_W: case CVT_W_D:
+                resultData = arithmeticResult(fetched.decoded.type(), Vj, Vk);
+                break;
+            case DIV:
+                if (Vk == 0) { /* Tratamento de divisão por zero. */ *err << "Erro: Divisao por zero na instrucao " << originalInstIndex << "!" << endl; }
+                resultData = arithmeticResult(DIV, Vj, Vk);
+                break;
+            case LOAD:
+                effectiveAddr = effectiveAddress(rs->A, Vk); // A (offset) + Vk (valor do registrador base).
+                // Simula leitura da memória (com a fila de LOADs/STOREs, o valor já foi lido no início da execução).
+                if (memory.contains(effectiveAddr)) resultData = MEMORY_ORDER == MEMORY_ORDER_NONE ? memory.read(effectiveAddr) : rob[producingRobIdx].value;
+                else { /* Tratamento de acesso inválido à memória. */ *err << "Erro: Endereco de LOAD invalido (" << effectiveAddr << ") para inst " << originalInstIndex << endl; resultData = 0; }
+                rob[producingRobIdx].address = effectiveAddr; // Armazena o endereço calculado na entrada do ROB.
+                break;
+            case STORE:
+                effectiveAddr = effectiveAddress(rs->A, Vk);
+                rob[producingRobIdx].address = effectiveAddr; // Armazena o endereço calculado.
+                // O valor a ser armazenado (rs->Vj) já deveria estar em rob[producingRobIdx].value
+                // se foi obtido no Issue ou atualizado por updateDependentRS.
+                // Aqui, 'resultData' para STORE efetivamente é o valor que estava em Vj.
+                resultData = Vj;
+                break;
+            case BEQ: case BNE: case JUMP: // J não passa pelo CDB (fica pronto na emissão).
+                resultData = fetched.decoded.type() == JUMP || ((Vj == Vk) == (fetched.decoded.type() == BEQ)) ? 1 : 0;
+                // Direção diferente da seguida pela busca: o caminho errado é descartado ao fim do WriteResult.
+                if ((resultData != 0) != fetched.predictedTaken) {
+                    if (mispredictedBranch < 0 || originalInstIndex < mispredictedBranch) mispredictedBranch = originalInstIndex;
+                    if (listener) {
+                        TraceRecord record;
+                        record.cycle = cycle; record.event = TRACE_MISPREDICT;
+                        record.instructionIndex = originalInstIndex; record.op = fetched.decoded.type(); record.robIndex = producingRobIdx;
+                        record.hasValue = true; record.value = resultData;
+                        listener->onEvent(record);
+                    }
+                }
+                break;
+            case INVALID: // Caso de instrução inválida detectada tardiamente.
+                *err << "Erro: Instrução inválida no WriteBack para índice " << originalInstIndex << endl;
+                resultData = 0; // Define um valor padrão para não deixar lixo.
+                // Considerar se o simulador deve parar ou sinalizar erro de forma mais forte.
+                return true; // Retornar aqui evita a atualização do ROB e a liberação da RS para uma instrução inválida.
+        }
+
+        if (listener) {
+            TraceRecord record;
+            record.cycle = cycle; record.event = TRACE_WRITE_RESULT;
+            record.instructionIndex = originalInstIndex; record.op = fetched.decoded.type(); record.robIndex = producingRobIdx;
+            record.hasValue = true; record.value = resultData;
+            listener->onEvent(record);
+        }
+
+        // Atualiza a entrada correspondente no ROB com o resultado/valor e muda o estado.
+        if (rob[producingRobIdx].busy) { // Verifica se a entrada do ROB ainda é relevante (não foi liberada).
+            int phys = rob[producingRobIdx].physicalRegister;
+            if (phys >= 0) { // rename = prf: o resultado vai só para o registrador físico.
+                physicalValues[phys] = resultData;
+                physicalReady[phys] = 1;
+                physicalProducer[phys] = -1;
+            } else {
+                rob[producingRobIdx].value = resultData;  // Armazena o resultado (ALU/LOAD) ou o dado (STORE).
+            }
+            rob[producingRobIdx].valueReady = true;       // Marca que o valor está pronto.
+            rob[producingRobIdx].state = ROB_WRITERESULT; // Pronta para ser considerada pelo Commit.
+
+            // Transmite o resultado (valor e o ÍNDICE DO ROB que o produziu) para as RSs dependentes.
+            // Isso é o "forwarding" através do CDB.
+            updateDependentRS(producingRobIdx, resultData);
+        }
+
+        // Libera a Estação de Reserva, tornando-a disponível para novas instruções.
+        rs->busy = false;
+        rsBusyCount[event.rsType]--;
+        markRSFree(event.rsType, event.rsIndex);
+        if (THREAD_COUNT > 1) threadBusyRS[activeThread]--;
+        rs->instructionIndex = -1; // Limpa associação com instrução.
+        rs->Qj = TAG_READY; rs->Qk = TAG_READY; rs->Vj = 0; rs->Vk = 0; rs->Pj = rs->Pk = -1; rs->A = 0; rs->destRobIndex = -1; // Reseta campos.
+        return true;
+    }
+
+    // Atualiza as RSs que esperavam por um resultado que acabou de ser disponibilizado
+    // no CDB (identificado por 'producingRobIdx'). Só as RSs registradas como consumidoras
+    // dessa tag são visitadas; as que ficam com os dois operandos prontos entram em readyRS.
+    void updateDependentRS(int producingRobIdx, Word resultValue) {
+        vector<TagConsumer> &consumers = robConsumers[producingRobIdx];
+        for (size_t i = 0; i < consumers.size(); ++i) {
+            const TagConsumer &consumer = consumers[i];
+            ReservationStation &currentRS = stationAt(consumer.group, consumer.slot);
+            if (!currentRS.busy) continue; // Apenas RSs ocupadas podem estar esperando.
+            if (!consumer.isQk && currentRS.Qj == producingRobIdx) { // Operando Qj aguardava esta tag.
+                if (currentRS.Pj < 0) currentRS.Vj = resultValue; // Fornece o valor (com rename = prf, já está no físico).
+                currentRS.Qj = TAG_READY;   // Limpa a tag de espera, operando agora está pronto.
+                stats.qjWait.add(cycle - inFlight(currentRS.instructionIndex).timing.issue);
+
+                // Tratamento especial para STORE: se Qj era o operando de DADO (fonte do valor a ser armazenado),
+                // e esse valor acabou de ficar pronto, ele precisa ser propagado para a entrada do ROB do STORE.
+                if (currentRS.op == STORE) {
+                    int storeOwnRobIdx = currentRS.destRobIndex; // Índice do ROB do próprio STORE.
+                    // Verifica se a entrada do ROB do STORE ainda é válida.
+                    if (rob[storeOwnRobIdx].busy) {
+                        rob[storeOwnRobIdx].value = resultValue; // Atualiza o valor a ser armazenado.
+                        rob[storeOwnRobIdx].valueReady = true;   // Marca que o dado está pronto.
+                    }
+                }
+            } else if (consumer.isQk && currentRS.Qk == producingRobIdx) { // Operando Qk aguardava esta tag.
+                if (currentRS.Pk < 0) currentRS.Vk = resultValue; // Fornece o valor.
+                currentRS.Qk = TAG_READY;   // Limpa a tag de espera.
+                stats.qkWait.add(cycle - inFlight(currentRS.instructionIndex).timing.issue);
+                // Base de um LOAD/STORE pronta: o endereço já pode ser calculado.
+                if ((currentRS.op == LOAD || currentRS.op == STORE) && MEMORY_ORDER != MEMORY_ORDER_NONE) resolveAddress(currentRS);
+            } else {
+                continue; // Registro antigo: a RS já não espera por esta tag.
+            }
+            // Se ambos Qj e Qk agora são TAG_READY, a RS passa a ser candidata a `startExecution`.
+            if (currentRS.Qj == TAG_READY && currentRS.Qk == TAG_READY) {
+                readyRS[consumer.group].push_back(consumer.slot);
+                stats.operandWait.add(cycle - inFlight(currentRS.instructionIndex).timing.issue);
+            }
+        }
+        consumers.clear(); // A tag não será mais transmitida até a entrada do ROB ser reutilizada.
+    }
+
+    // Lógica do estágio de Commit.
+    // Efetiva o resultado da instrução na cabeça do ROB no estado arquitetural (registradores ou memória).
+    // Garante a finalização em ordem das instruções. Retorna true se uma instrução foi cometida.
+    bool commitInstruction() {
+        // Condições para não cometer: ROB vazio ou a entrada na cabeça não está ocupada/pronta.
+        if (robEntriesAvailable == ROB_SIZE || !rob[robHead].busy) return false;
+
+        ReorderBufferEntry &headEntry = rob[robHead]; // Referência à entrada na cabeça do ROB.
+
+        // Uma instrução só pode ser cometida se seu resultado já foi escrito no ROB (estado ROB_WRITERESULT).
+        if (headEntry.state == ROB_WRITERESULT) {
+            // Condição adicional para STORE: o VALOR a ser armazenado DEVE estar pronto.
+            // O endereço pode estar pronto (estado WriteResult), mas o dado (value) não.
+            if (headEntry.type == STORE && !headEntry.valueReady) {
+                // Se um STORE está na cabeça do ROB, mas seu dado ainda não está pronto
+                // (ex: dependia de um LOAD longo), ele bloqueia o commit de todas as instruções subsequentes.
+                // Este é um ponto crucial para a corretude da memória com STOREs.
+                return false; // Não pode cometer este STORE ainda.
+            }
+
+            // Co-simulação: uma divergência do modelo de referência para a simulação antes do commit.
+            if (cosimEnabled && !checkCommit(headEntry)) return false;
+
+            Instruction &originalInst = inFlight(headEntry.instructionIndex).timing; // Timing da instrução original.
+            originalInst.commitCycle = cycle; // Registra o ciclo de commit.
+
+            string committedActionLog; // String para log do que foi efetivado.
+
+            // Efetiva a escrita no estado arquitetural.
+            if (isControlFlow(headEntry.type)) { // Desvio: nada a escrever; treina o preditor.
+                const InFlightInstruction &branch = inFlight(headEntry.instructionIndex);
+                bool taken = headEntry.value != 0;
+                if (headEntry.type == JUMP) {
+                    stats.jumps++;
+                } else {
+                    predictor.update(branch.pc, branch.historyBefore, taken);
+                    stats.branches++;
+                    if (taken) stats.takenBranches++;
+                    if (taken != branch.predictedTaken) stats.mispredictions++;
+                }
+                if (commitLogEnabled) committedActionLog = taken ? "desvio tomado -> " + to_string(branch.decoded.imm) : "desvio nao tomado";
+            } else if (headEntry.type != STORE) { // Para ADD, SUB, MUL, DIV, LOAD: atualiza registrador.
+                Word value = entryResult(headEntry);
+                registers[headEntry.destinationRegister] = value;
+                if (commitLogEnabled) committedActionLog = registerName(headEntry.destinationRegister) + " = " + registerValueText(headEntry.destinationRegister, value);
+                // rename = prf: o mapeamento anterior do destino não é mais visível e volta à lista livre.
+                if (headEntry.previousPhysical >= 0) freePhysical.push_back(headEntry.previousPhysical);
+                // Libera o status do registrador de destino se esta entrada do ROB
+                // era a última que estava produzindo valor para ele.
+                RegisterStatus &destStatus = regStatus[headEntry.destinationRegister];
+                if (destStatus.busy && destStatus.robIndex == robHead) {
+                    destStatus.busy = false;
+                    destStatus.robIndex = -1; // Registrador agora tem valor atualizado.
+                }
+            } else { // Para STORE: atualiza memória.
+                // É importante verificar a validade do endereço antes de escrever.
+                if (memory.contains(headEntry.address)) { // Limites da memória simulada.
+                    memory.write(headEntry.address, headEntry.value);
+                    if (commitLogEnabled) {
+                        committedActionLog = "MEM[" + to_string(headEntry.address) + "] = " +
+                                             wordText(headEntry.value, storesDouble(inFlight(headEntry.instructionIndex).decoded));
+                    }
+                } else {
+                    // Erro grave: tentativa de escrita em endereço inválido no commit.
+                    // O comportamento aqui (logar, parar, etc.) depende dos requisitos.
+                    *err << "Erro CRITICO no Commit: Endereco de STORE invalido: " << headEntry.address << " para inst " << headEntry.instructionIndex << endl;
+                    committedActionLog = "STORE ERRO - Endereco Invalido";
+                    // Por ora, a instrução é "cometida" (ROB liberado) mas com o erro logado.
+                    // Em um sistema real, isso poderia gerar uma exceção.
+                }
+            }
+
+            // Log da ação de commit para depuração/visualização.
+            // Com SMT, a linha diz a thread ("Commit T1 Inst 3"); o índice e o ROB são os dela.
+            if (commitLogEnabled) *out << "Ciclo " << cycle << ": Commit " << (THREAD_COUNT > 1 ? "T" + to_string(activeThread) + " " : "")
+                                       << "Inst " << headEntry.instructionIndex << " (ROB " << robHead << "): " << committedActionLog << endl;
+            if (listener) {
+                TraceRecord record;
+                record.cycle = cycle; record.event = TRACE_COMMIT;
+                record.instructionIndex = headEntry.instructionIndex; record.op = headEntry.type; record.robIndex = robHead;
+                record.hasValue = true; record.value = entryResult(headEntry);
+                record.destReg = headEntry.destinationRegister >= 0 ? registerCode(headEntry.destinationRegister) : -1;
+                record.address = headEntry.address;
+                listener->onEvent(record);
+            }
+
+            if (headEntry.type == LOAD) loadQueue.pop_front(); // A cabeça do ROB é o LOAD/STORE mais antigo.
+            else if (headEntry.type == STORE) storeQueue.pop_front();
+
+            // A instrução sai da janela de busca (e vai para o histórico, se mantido).
+            if (keepHistory) history.push_back(inFlight(headEntry.instructionIndex));
+            committedCount++;
+
+            // Libera a entrada do ROB.
+            headEntry.busy = false;
+            headEntry.state = ROB_EMPTY; // Marca como vazia para reutilização.
+            robHead = robHead + 1 == ROB_SIZE ? 0 : robHead + 1; // Avança a cabeça do ROB (circular, sem divisão).
+            robEntriesAvailable++;
+            stats.committedInstructions++;
+            if (THREAD_COUNT > 1) {
+                threadCommitted[activeThread]++;
+                threadLastCommit[activeThread] = cycle;
+            }
+            return true;
+        }
+        // Se headEntry.state não for ROB_WRITERESULT, a cabeça do ROB está bloqueada,
+        // e nenhuma instrução (mesmo as prontas subsequentes) pode ser cometida devido à política de commit em ordem.
+        return false;
+    }
+
+    // --- Co-simulação ---
+    // Efeito de um commit de 'inst' em texto ("F1 = 3", "MEM[8] = 5", "tomado -> 12").
+    string effectText(const DecodedInstruction &inst, int destReg, Word value, int address, bool taken) const {
+        InstructionType type = inst.type();
+        if (isControlFlow(type)) return taken ? "tomado -> " + to_string(inst.imm) : "nao tomado";
+        if (type == STORE) return address >= 0 ? "MEM[" + to_string(address) + "] = " + wordText(value, storesDouble(inst)) : "endereco invalido";
+        return registerName(destReg) + " = " + registerValueText(destReg, value);
+    }
+
+    // Confere o commit da cabeça do ROB com o próximo passo do modelo de referência: a posição
+    // da instrução (o fluxo de controle) e o que ela escreve (registrador e valor, endereço e
+    // valor do STORE, direção do desvio). Na primeira divergência imprime o contexto em 'err',
+    // interrompe a simulação e retorna false.
+    bool checkCommit(const ReorderBufferEntry &entry) {
+        const InFlightInstruction &committed = inFlight(entry.instructionIndex);
+        const DecodedInstruction &inst = committed.decoded;
+        int expectedPC = reference.pc();
+        string pipelineText, referenceText, operands;
+        if (committed.pc != expectedPC) {
+            pipelineText = "pc " + to_string(committed.pc);
+            referenceText = "pc " + to_string(expectedPC) + " (o fluxo de controle divergiu)";
+        } else {
+            const int src1Reg = registerIndex(inst.src1, FP_REGISTER_COUNT), src2Reg = registerIndex(inst.src2, FP_REGISTER_COUNT);
+            Word src1Value = src1Reg >= 0 ? reference.reg(src1Reg) : 0;
+            Word src2Value = src2Reg >= 0 ? reference.reg(src2Reg) : 0;
+            ReferenceModel::Effect expected = reference.step(inst);
+            bool taken = entry.value != 0;
+            int address = entry.type == STORE && memory.contains(entry.address) ? entry.address : -1;
+            Word value = entryResult(entry);
+            bool matches;
+            if (isControlFlow(entry.type)) matches = taken == expected.taken;
+            else if (entry.type == STORE) matches = address == expected.address && (address < 0 || entry.value == expected.value);
+            else matches = entry.destinationRegister == expected.destReg && value == expected.value;
+            if (matches) {
+                recentCommits[cosimChecked % COSIM_CONTEXT] = CheckedCommit{entry.instructionIndex, committed.pc, inst, expected};
+                cosimChecked++;
+                return true;
+            }
+            if (src1Reg >= 0) operands = registerNameOf(inst.src1) + " = " + registerValueText(src1Reg, src1Value);
+            if (src2Reg >= 0) operands += (operands.empty() ? "" : ", ") + registerNameOf(inst.src2) + " = " + registerValueText(src2Reg, src2Value);
+            pipelineText = effectText(inst, entry.destinationRegister, entry.type == STORE ? entry.value : value, address, taken);
+            referenceText = effectText(inst, expected.destReg, expected.value, expected.address, expected.taken);
+        }
+        cosimDiverged = true;
+        *err << "Divergencia na co-simulacao no ciclo " << cycle << ", commit da inst " << entry.instructionIndex
+             << " (pc " << committed.pc << "): " << decodedInstructionText(inst) << "\n"
+             << "  pipeline:   " << pipelineText << "\n"
+             << "  referencia: " << referenceText << "\n";
+        if (!operands.empty()) *err << "  operandos na referencia: " << operands << "\n";
+        long long shown = min<long long>(cosimChecked, COSIM_CONTEXT);
+        if (shown > 0) *err << "  commits anteriores (conferidos):\n";
+        for (long long i = cosimChecked - shown; i < cosimChecked; ++i) {
+            const CheckedCommit &previous = recentCommits[i % COSIM_CONTEXT];
+            *err << "    inst " << previous.instructionIndex << " (pc " << previous.pc << "): " << decodedInstructionText(previous.decoded) << "  "
+                 << effectText(previous.decoded, previous.effect.destReg, previous.effect.value, previous.effect.address,
+                               previous.effect.taken) << "\n";
+        }
+        err->flush();
+        return false;
+    }
+
+    // --- Escalonamento orientado a eventos ---
+    // Por que o Issue não consegue emitir a próxima instrução neste ciclo? (mesmas condições de issueInstruction()).
+    IssueStallCause issueBlockCause() {
+        if (nextInstructionIndex >= fetchedCount) return STALL_NO_INSTRUCTION;
+        if (robEntriesAvailable == 0) return STALL_ROB_FULL;
+        const DecodedInstruction &decoded = inFlight(nextInstructionIndex).decoded;
+        if (RENAME_MODE == RENAME_PRF && decoded.destReg() >= 0 && freePhysical.empty()) return STALL_PRF_FULL;
+        InstructionType type = decoded.type();
+        if (type == JUMP) return ISSUE_OK; // Só precisa do ROB.
+        pair<int, RSGroup> rsInfo = findFreeRS(type);
+        if (rsInfo.first != -1) return ISSUE_OK;
+        switch (type) {
+            case MUL: case DIV: return STALL_RS_MUL_FULL;
+            case LOAD: return STALL_RS_LOAD_FULL;
+            case STORE: return STALL_RS_STORE_FULL;
+            case ADD_D: case SUB_D: case CVT_D_W: case CVT_W_D: return STALL_RS_FPADD_FULL;
+            case MUL_D: case DIV_D: return STALL_RS_FPMUL_FULL;
+            default: return STALL_RS_ADD_FULL;
+        }
+    }
+
+    // O Issue consegue emitir a próxima instrução neste ciclo?
+    bool canIssue() { return issueBlockCause() == ISSUE_OK; }
+
+    // Amostras de ocupação ao fim do ciclo, com peso = quantidade de ciclos em que o estado se manteve.
+    void sampleOccupancy(long long weight) {
+        int robInUse = ROB_SIZE - robEntriesAvailable; // Com SMT, a soma das partições.
+        for (size_t t = 0; t < threads.size(); ++t) if (static_cast<int>(t) != activeThread) robInUse += ROB_SIZE - threads[t].robEntriesAvailable;
+        stats.robOccupancy.add(robInUse, weight);
+        for (int g = 0; g < RS_GROUP_COUNT; ++g) stats.rsOccupancy[g].add(rsBusyCount[g], weight);
+        if (RENAME_MODE == RENAME_PRF) {
+            stats.prfOccupancy.add(PHYSICAL_REGISTER_COUNT - REGISTER_COUNT - static_cast<int>(freePhysical.size()), weight);
+        }
+    }
+
+    // O Commit consegue efetivar a cabeça do ROB neste ciclo? (mesmas condições de commitInstruction()).
+    bool canCommit() const {
+        if (robEntriesAvailable == ROB_SIZE || !rob[robHead].busy) return false;
+        const ReorderBufferEntry &headEntry = rob[robHead];
+        return headEntry.state == ROB_WRITERESULT && !(headEntry.type == STORE && !headEntry.valueReady);
+    }
+
+    // Com SMT: alguma thread consegue cometer ou emitir neste ciclo? (Antes de startThreads(),
+    // as threads ainda vão buscar a primeira instrução: conta como sim.)
+    bool anyThreadCanAdvance() {
+        if (!threadsStarted) return true;
+        int current = activeThread;
+        bool any = false;
+        for (int t = 0; t < THREAD_COUNT && !any; ++t) {
+            selectThread(t);
+            any = canCommit() || canIssue();
+        }
+        selectThread(current);
+        return any;
+    }
+
+    // Paradas do Issue nos 'skipped' ciclos pulados a partir do atual. Com SMT, como no
+    // stepSimulation(), vale o motivo da primeira thread (na ordem de cada ciclo) que tinha
+    // instrução; os motivos não mudam nos ciclos pulados, só a rotação das threads.
+    void recordSkippedIssueStalls(int skipped) {
+        if (THREAD_COUNT == 1) { stats.issueStallCycles[issueBlockCause()] += skipped; return; }
+        int current = activeThread;
+        vector<IssueStallCause> causes(THREAD_COUNT);
+        for (int t = 0; t < THREAD_COUNT; ++t) { selectThread(t); causes[t] = issueBlockCause(); }
+        selectThread(current);
+        for (int r = 0; r < THREAD_COUNT && r < skipped; ++r) { // Os ciclos com a mesma rotação.
+            orderThreadsForIssue(cycle + r);
+            IssueStallCause cause = STALL_NO_INSTRUCTION;
+            for (int k = 0; k < THREAD_COUNT && cause == STALL_NO_INSTRUCTION; ++k) cause = causes[threadOrder[k]];
+            stats.issueStallCycles[cause] += (skipped - r + THREAD_COUNT - 1) / THREAD_COUNT;
+        }
+    }
+
+    // Calcula o próximo ciclo (>= cycle) em que algum estágio pode alterar o estado.
+    // Enquanto o CDB está vazio e o Commit e o Issue estão bloqueados, os únicos eventos
+    // possíveis são a conclusão de uma instrução na roda de execução e a liberação de uma
+    // unidade funcional esperada por uma RS pronta.
+    int nextEventCycle() {
+        if (!completedForCDB.empty()) return cycle;
+        if (THREAD_COUNT == 1 ? canCommit() || canIssue() : anyThreadCanAdvance()) return cycle;
+        int next = numeric_limits<int>::max();
+        int current = activeThread;
+        for (int g = 0; g < RS_GROUP_COUNT; ++g) {
+            for (size_t k = 0; k < readyRS[g].size(); ++k) {
+                const ReservationStation &rs = stationAt(static_cast<RSGroup>(g), readyRS[g][k]);
+                selectThread(rs.thread); // Com SMT, os STOREs mais antigos são os da thread dona.
+                int blockedLevel = -1;
+                switch (readyBlockCause(rs, blockedLevel)) {
+                    case READY_CAN_START: selectThread(current); return cycle;
+                    case READY_WAIT_STORE: break; // Só um WriteResult libera o LOAD.
+                    case READY_WAIT_UNIT: {
+                        const FunctionalUnitPool &pool = fuPools[functionalUnitFor(rs.op)];
+                        for (size_t u = 0; u < pool.nextFreeCycle.size(); ++u) next = min(next, pool.nextFreeCycle[u]);
+                        break;
+                    }
+                    case READY_WAIT_MSHR: next = min(next, caches.nextMshrFree(cycle)); break;
+                }
+            }
+        }
+        selectThread(current);
+        if (executingCount > 0) {
+            for (int delta = 0; delta < WHEEL_SIZE; ++delta) {
+                if (!executionWheel[(cycle + delta) % WHEEL_SIZE].empty()) { next = min(next, cycle + delta); break; }
+            }
+        }
+        // Nada em voo: não há evento futuro para esperar.
+        return next == numeric_limits<int>::max() ? cycle : next;
+    }
+
+    // --- Snapshot ---
+    // Grava ou restaura (conforme o 'ar') todo o estado que muda durante a simulação.
+    // Os parâmetros da máquina não são gravados: os que determinam a forma do estado são
+    // conferidos, e o restante (latências, unidades funcionais, políticas) vem da máquina atual.
+    // O histórico de printStatus não entra no snapshot: depois de restaurar, ele começa no ponto
+    // de restauração. No modo streaming, grava-se a posição no arquivo de texto.
+    template <class Archive>
+    void transferState(Archive &ar) {
+        ar.expect(static_cast<int>(ROB_SIZE), "rob");
+        ar.expect(static_cast<int>(ADD_RS_COUNT), "rs.add");
+        ar.expect(static_cast<int>(MUL_RS_COUNT), "rs.mul");
+        ar.expect(static_cast<int>(LOAD_RS_COUNT), "rs.load");
+        ar.expect(static_cast<int>(STORE_RS_COUNT), "rs.store");
+        ar.expect(static_cast<int>(FPADD_RS_COUNT), "rs.fpadd");
+        ar.expect(static_cast<int>(FPMUL_RS_COUNT), "rs.fpmul");
+        ar.expect(FP_REGISTER_COUNT, "registers");
+        ar.expect(REGISTER_COUNT - FP_REGISTER_COUNT, "registers.int");
+        ar.expect(MEMORY_ORDER, "memory_order");
+        ar.expect(RENAME_MODE, "rename");
+        ar.expect(PHYSICAL_REGISTER_COUNT, "prf.size");
+        ar.expect(ISSUE_WIDTH, "issue_width");
+        ar.expect(CDB_COUNT, "cdbs");
+        ar.expect(COMMIT_WIDTH, "commit_width");
+        // Tamanho do programa (-1 no modo streaming, onde não é conhecido).
+        long long programSize = streaming ? -1 : static_cast<long long>(activeProgram->size());
+        long long savedProgramSize = programSize;
+        ar(savedProgramSize);
+        if (ar.loading() && ar.ok() && programSize >= 0 && savedProgramSize >= 0 && savedProgramSize != programSize) {
+            ar.fail("o programa carregado nao e o do snapshot (" + to_string(savedProgramSize) + " instrucoes no snapshot, " +
+                    to_string(programSize) + " no programa)");
+        }
+
+        ar(cycle); ar(nextInstructionIndex);
+        ar(robHead); ar(robTail); ar(robEntriesAvailable);
+        ar(fetchedCount); ar(committedCount); ar(fetchPC); ar(sourceExhausted);
+        if (ar.loading() && ar.ok() &&
+            (committedCount < 0 || nextInstructionIndex < committedCount || fetchedCount < nextInstructionIndex ||
+             fetchedCount - committedCount > FETCH_WINDOW_SIZE || fetchPC < 0 ||
+             robHead < 0 || robHead >= ROB_SIZE || robTail < 0 || robTail >= ROB_SIZE ||
+             robEntriesAvailable < 0 || robEntriesAvailable > ROB_SIZE)) {
+            ar.fail("contadores de busca/ROB invalidos");
+        }
+        for (int i = committedCount; i < fetchedCount && ar.ok(); ++i) ar(inFlight(i));
+        // Com o programa inteiro carregado, as instruções em voo precisam ser as do programa.
+        for (int i = committedCount; ar.loading() && ar.ok() && !streaming && i < fetchedCount; ++i) {
+            const InFlightInstruction &slot = inFlight(i);
+            if (slot.pc < 0 || slot.pc >= programSize ||
+                memcmp(&slot.decoded, &(*activeProgram)[slot.pc], sizeof(DecodedInstruction)) != 0) ar.fail("o programa carregado nao e o do snapshot");
+        }
+        if (ar.loading()) { history.clear(); historyStart = committedCount; }
+
+        snapshotSized(ar, addRS, "rs.add");
+        snapshotSized(ar, mulRS, "rs.mul");
+        snapshotSized(ar, loadRS, "rs.load");
+        snapshotSized(ar, storeRS, "rs.store");
+        snapshotSized(ar, fpAddRS, "rs.fpadd");
+        snapshotSized(ar, fpMulRS, "rs.fpmul");
+        snapshotSized(ar, rob, "rob");
+        snapshotSized(ar, registers, "registers");
+        snapshotSized(ar, regStatus, "registers");
+        if (RENAME_MODE == RENAME_PRF) {
+            snapshotSized(ar, renameMap, "registers");
+            snapshotSized(ar, physicalValues, "prf.size");
+            snapshotSized(ar, physicalReady, "prf.size");
+            snapshotSized(ar, physicalProducer, "prf.size");
+            vector<int> freeList(freePhysical.begin(), freePhysical.end());
+            snapshotItems(ar, freeList);
+            if (ar.loading()) freePhysical.assign(freeList.begin(), freeList.end());
+        }
+        memory.transfer(ar);
+        vector<int> loads(loadQueue.begin(), loadQueue.end()), stores(storeQueue.begin(), storeQueue.end());
+        snapshotItems(ar, loads);
+        snapshotItems(ar, stores);
+        if (ar.loading()) { loadQueue.assign(loads.begin(), loads.end()); storeQueue.assign(stores.begin(), stores.end()); }
+        ar(replayFrom); ar(mispredictedBranch);
+        caches.transfer(ar);
+        predictor.transfer(ar);
+        for (int t = 0; t < FU_TYPE_COUNT && ar.ok(); ++t) {
+            snapshotSized(ar, fuPools[t].nextFreeCycle, "unidades funcionais");
+            ar(fuPools[t].operations); ar(fuPools[t].stallCycles);
+        }
+
+        // Roda de execução: os eventos com a distância (em ciclos) até a conclusão, em ordem.
+        uint64_t eventCount = executingCount;
+        ar(eventCount);
+        if (!ar.loading()) {
+            for (int delta = 0; delta < WHEEL_SIZE; ++delta) {
+                vector<CompletionEvent> &bucket = executionWheel[(cycle + delta) % WHEEL_SIZE];
+                for (size_t e = 0; e < bucket.size(); ++e) { ar(delta); ar(bucket[e]); }
+            }
+        } else {
+            for (int b = 0; b < WHEEL_SIZE; ++b) executionWheel[b].clear();
+            executingCount = 0;
+            if (eventCount > ar.remaining()) ar.fail("snapshot truncado");
+            for (uint64_t e = 0; e < eventCount && ar.ok(); ++e) {
+                int delta = 0;
+                CompletionEvent event = CompletionEvent();
+                ar(delta); ar(event);
+                // Uma latência menor na máquina atual não muda os eventos já agendados.
+                if (delta < 0 || delta >= WHEEL_SIZE) { ar.fail("evento de execucao fora da roda (latencias menores que as do snapshot?)"); break; }
+                executionWheel[(cycle + delta) % WHEEL_SIZE].push_back(event);
+                executingCount++;
+            }
+        }
+        vector<CompletionEvent> waitingCDB;
+        for (queue<CompletionEvent> copy = completedForCDB; !copy.empty(); copy.pop()) waitingCDB.push_back(copy.front());
+        snapshotItems(ar, waitingCDB);
+        if (ar.loading()) {
+            completedForCDB = queue<CompletionEvent>();
+            for (size_t e = 0; e < waitingCDB.size(); ++e) completedForCDB.push(waitingCDB[e]);
+        }
+
+        ar.expect(static_cast<uint64_t>(robConsumers.size()), "rob");
+        for (size_t r = 0; r < robConsumers.size() && ar.ok(); ++r) snapshotItems(ar, robConsumers[r]);
+        for (int g = 0; g < RS_GROUP_COUNT; ++g) { snapshotItems(ar, readyRS[g]); ar(rsBusyCount[g]); }
+        ar(stats);
+
+        long long streamOffset = streaming && streamFile.is_open() ? static_cast<long long>(streamFile.tellg()) : -1;
+        ar(streamOffset);
+        // Snapshot do modo streaming: a impressão digital do arquivo de texto já lido, para
+        // recusar outro programa (o programa inteiro é conferido pelas instruções em voo, acima).
+        long long streamFileSize = -1;
+        uint64_t streamHash = 0;
+        if (!ar.loading() && streaming) fingerprintStreamFile(streamOffset, streamFileSize, streamHash);
+        ar(streamFileSize); ar(streamHash);
+        if (ar.loading()) rebuildFreeRS();
+        if (ar.loading() && ar.ok()) {
+            long long currentSize = -1;
+            uint64_t currentHash = 0;
+            if (streaming && savedProgramSize < 0) fingerprintStreamFile(streamOffset, currentSize, currentHash);
+            if (!snapshotIndicesValid()) ar.fail("indices de RS/ROB invalidos");
+            else if (streaming && savedProgramSize < 0 && (currentSize != streamFileSize || currentHash != streamHash)) {
+                ar.fail("o programa carregado nao e o do snapshot (o arquivo de texto " + streamFilename + " e outro)");
+            } else if (streaming && !restoreStreamPosition(streamOffset)) ar.fail("o programa carregado nao e o do snapshot");
+        }
+    }
+
+    // Impressão digital do arquivo do modo streaming: o tamanho e o hash FNV-1a dos 'length'
+    // primeiros bytes (-1: do arquivo inteiro, que já foi todo lido).
+    void fingerprintStreamFile(long long length, long long &size, uint64_t &hash) const {
+        ifstream file(streamFilename.c_str(), ios::binary);
+        file.seekg(0, ios::end);
+        size = file ? static_cast<long long>(file.tellg()) : -1;
+        file.seekg(0);
+        hash = 14695981039346656037ULL;
+        char buffer[1 << 16];
+        for (long long left = length < 0 ? size : length; left > 0 && file; ) {
+            file.read(buffer, static_cast<streamsize>(min<long long>(left, sizeof(buffer))));
+            for (streamsize i = 0; i < file.gcount(); ++i) hash = (hash ^ static_cast<unsigned char>(buffer[i])) * 1099511628211ULL;
+            left -= file.gcount();
+        }
+    }
+
+    // Confere os índices restaurados que endereçam as estruturas (RSs, ROB, registradores).
+    bool snapshotIndicesValid() {
+        auto validRob = [&](int index) { return index >= 0 && index < ROB_SIZE; };
+        auto validTag = [&](int tag) { return tag == TAG_READY || validRob(tag); };
+        auto validSlot = [&](RSGroup group, int slot) { return group >= 0 && group < RS_GROUP_COUNT && slot >= 0 && slot < groupSize(group); };
+        auto validEvent = [&](const CompletionEvent &event) { return validSlot(event.rsType, event.rsIndex) && validRob(event.robIndex); };
+        for (int g = 0; g < RS_GROUP_COUNT; ++g) {
+            for (int slot = 0; slot < groupSize(static_cast<RSGroup>(g)); ++slot) {
+                const ReservationStation &rs = stationAt(static_cast<RSGroup>(g), slot);
+                if (rs.busy && (!validTag(rs.Qj) || !validTag(rs.Qk) || !validRob(rs.destRobIndex))) return false;
+            }
+            for (size_t i = 0; i < readyRS[g].size(); ++i) if (!validSlot(static_cast<RSGroup>(g), readyRS[g][i])) return false;
+        }
+        for (int r = 0; r < ROB_SIZE; ++r) {
+            const ReorderBufferEntry &entry = rob[r];
+            if (entry.busy && (entry.instructionIndex < committedCount || entry.instructionIndex >= fetchedCount ||
+                               entry.destinationRegister >= REGISTER_COUNT)) return false;
+            for (size_t c = 0; c < robConsumers[r].size(); ++c) if (!validSlot(robConsumers[r][c].group, robConsumers[r][c].slot)) return false;
+        }
+        for (int reg = 0; reg < REGISTER_COUNT; ++reg) if (regStatus[reg].busy && !validRob(regStatus[reg].robIndex)) return false;
+        // rename = prf: todos os índices de registradores físicos dentro do banco.
+        auto validPhys = [&](int phys, bool optional) { return (optional && phys == -1) || (phys >= 0 && phys < PHYSICAL_REGISTER_COUNT); };
+        for (int reg = 0; reg < static_cast<int>(renameMap.size()); ++reg) if (!validPhys(renameMap[reg], false)) return false;
+        for (size_t i = 0; i < freePhysical.size(); ++i) if (!validPhys(freePhysical[i], false)) return false;
+        for (int phys = 0; phys < PHYSICAL_REGISTER_COUNT; ++phys) {
+            if (!physicalReady[phys] && !validRob(physicalProducer[phys])) return false;
+        }
+        for (int r = 0; r < ROB_SIZE; ++r) {
+            if (!validPhys(rob[r].physicalRegister, true) || !validPhys(rob[r].previousPhysical, true)) return false;
+            if (rob[r].physicalRegister >= 0 && rob[r].destinationRegister < 0) return false;
+        }
+        for (int g = 0; g < RS_GROUP_COUNT; ++g) {
+            for (int slot = 0; slot < groupSize(static_cast<RSGroup>(g)); ++slot) {
+                const ReservationStation &rs = stationAt(static_cast<RSGroup>(g), slot);
+                if (!validPhys(rs.Pj, true) || !validPhys(rs.Pk, true)) return false;
+            }
+        }
+        for (size_t i = 0; i < loadQueue.size(); ++i) if (!validRob(loadQueue[i])) return false;
+        for (size_t i = 0; i < storeQueue.size(); ++i) if (!validRob(storeQueue[i])) return false;
+        for (int b = 0; b < WHEEL_SIZE; ++b) {
+            for (size_t e = 0; e < executionWheel[b].size(); ++e) if (!validEvent(executionWheel[b][e])) return false;
+        }
+        for (queue<CompletionEvent> copy = completedForCDB; !copy.empty(); copy.pop()) if (!validEvent(copy.front())) return false;
+        return true;
+    }
+
+    // Modo streaming: reposiciona o arquivo de texto depois de uma restauração. Um snapshot
+    // de um programa carregado inteiro não tem a posição; as instruções já buscadas são puladas,
+    // e as que estão em voo precisam ser as do arquivo. Retorna false se o arquivo não é o do snapshot.
+    bool restoreStreamPosition(long long offset) {
+        if (sourceExhausted) { streamFile.close(); return true; }
+        streamFile.clear();
+        if (offset > 0) { // A posição gravada é sempre o início de uma linha.
+            streamFile.seekg(offset - 1);
+            return streamFile.get() == '\n';
+        }
+        if (offset == 0) return true;
+        streamFile.seekg(0);
+        DecodedInstruction skipped;
+        int pc = 0;
+        while (pc < fetchPC && getline(streamFile, streamLine)) {
+            if (!Program::decodeLine(streamLine, skipped, FP_REGISTER_COUNT, REGISTER_COUNT - FP_REGISTER_COUNT, *err)) continue;
+            for (int i = committedCount; i < fetchedCount; ++i) {
+                if (inFlight(i).pc == pc && memcmp(&inFlight(i).decoded, &skipped, sizeof(DecodedInstruction)) != 0) return false;
+            }
+            ++pc;
+        }
+        return pc == fetchPC;
+    }
+
+    // Modo funcional: a próxima instrução na ordem real de execução. A instrução já buscada ao
+    // carregar o programa é a primeira; as demais vêm da fonte. Retorna false no fim do programa.
+    bool takeFunctionalInstruction(DecodedInstruction &inst, int &pc, unsigned &historyBefore) {
+        if (fetchedCount > committedCount) {
+            const InFlightInstruction &fetched = inFlight(committedCount);
+            inst = fetched.decoded;
+            pc = fetched.pc;
+            historyBefore = fetched.historyBefore;
+            fetchedCount--;
+            return true;
+        }
+        if (sourceExhausted || !readNextInstruction(inst)) {
+            sourceExhausted = true;
+            if (streaming) streamFile.close();
+            return false;
+        }
+        pc = fetchPC;
+        historyBefore = predictor.getHistory();
+        return true;
+    }
+
+    // Executa uma instrução só sobre o estado arquitetural, aquecendo caches e preditor.
+    // 'address' recebe o endereço acessado por um LOAD/STORE válido (-1 nos demais casos).
+    // Retorna a posição da próxima instrução.
+    int executeFunctional(const DecodedInstruction &inst, int pc, unsigned historyBefore, int index, int &address) {
+        int nextPC = pc + 1;
+        address = -1;
+        // Índices no banco (os R depois dos F); src2 não é lido em ADDI/SUBI, CVT e J.
+        const int dest = registerIndex(inst.dest, FP_REGISTER_COUNT), src1 = registerIndex(inst.src1, FP_REGISTER_COUNT);
+        const int src2 = registerIndex(inst.src2, FP_REGISTER_COUNT);
+        switch (inst.type()) {
+            case ADD: case SUB: case MUL:
+            case ADD_D: case SUB_D: case MUL_D: case DIV_D:
+                registers[dest] = arithmeticResult(inst.type(), registers[src1], registers[src2]);
+                break;
+            case ADDI: case SUBI: registers[dest] = arithmeticResult(inst.type(), registers[src1], inst.imm); break;
+            case CVT_D_W: case CVT_W_D: registers[dest] = arithmeticResult(inst.type(), registers[src1], 0); break;
+            case DIV:
+                if (registers[src2] == 0) *err << "Erro: Divisao por zero na instrucao " << index << "!" << endl;
+                registers[dest] = arithmeticResult(DIV, registers[src1], registers[src2]);
+                break;
+            case LOAD: {
+                int target = effectiveAddress(inst.imm, registers[src2]);
+                if (memory.contains(target)) { registers[dest] = memory.read(target); caches.warm(target); address = target; }
+                else { *err << "Erro: Endereco de LOAD invalido (" << target << ") para inst " << index << endl; registers[dest] = 0; }
+                break;
+            }
+            case STORE: {
+                int target = effectiveAddress(inst.imm, registers[src2]);
+                if (memory.contains(target)) { memory.write(target, registers[src1]); caches.warm(target); address = target; }
+                else *err << "Erro no modo funcional: Endereco de STORE invalido: " << target << " para inst " << index << endl;
+                break;
+            }
+            case BEQ: case BNE: {
+                bool taken = (registers[src1] == registers[src2]) == (inst.type() == BEQ);
+                predictor.update(pc, historyBefore, taken);
+                predictor.recover(historyBefore, taken);
+                if (taken) nextPC = inst.imm;
+                break;
+            }
+            case JUMP: nextPC = inst.imm; break;
+            default: break;
+        }
+        return nextPC;
+    }
+
+    // Entrega ao pipeline depois do modo funcional: as 'executed' instruções contam como já cometidas.
+    void handOffToPipeline(int executed) {
+        committedCount += executed;
+        fetchedCount = nextInstructionIndex = committedCount;
+        history.clear();
+        historyStart = committedCount;
+        resetPhysicalRegisters(); // Nada em voo: os físicos recebem o estado arquitetural.
+        fetchNextInstruction();
+        if (cosimEnabled) enableCosimulation();
+    }
+
+    // Lê um programa binário para 'target' e valida o opcode e os registradores de cada registro.
+    bool readBinaryProgram(Program &target, const string &filename) {
+        string error;
+        if (!target.loadBinary(filename, error)) {
+            *err << "Erro ao carregar programa binario " << filename << ": " << error << endl;
+            return false;
+        }
+        long long invalid = target.findInvalidInstruction(FP_REGISTER_COUNT, REGISTER_COUNT - FP_REGISTER_COUNT);
+        if (invalid >= 0) {
+            *err << "Instrucao binaria invalida no indice " << invalid << " (" << filename << ")" << endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Recursos que ainda não funcionam com SMT: imprime o erro e retorna false.
+    bool singleThreadOnly(const char *feature) const {
+        if (THREAD_COUNT == 1) return true;
+        *err << "Erro: " << feature << " nao suporta smt.threads > 1" << endl;
+        return false;
+    }
+
+    // Valor inicial arbitrário (10) para todos os registradores; com registers.int > 0, os F
+    // guardam doubles e começam com 10.0.
+    static vector<Word> initialRegisters(const MachineConfig &config) {
+        vector<Word> values(config.registerCount + config.intRegisterCount, 10);
+        if (config.intRegisterCount > 0) std::fill(values.begin(), values.begin() + config.registerCount, doubleToWord(10.0));
+        return values;
+    }
+
+public:
+    // Cria o simulador para uma descrição de máquina.
+    explicit TomasuloSimulatorCore(const MachineConfig &config) :
+        Shape(config),
+        registers(initialRegisters(config)),
+        regStatus(config.registerCount + config.intRegisterCount), // busy=false, robIndex=-1 por padrão.
+        FP_REGISTER_COUNT(config.registerCount),
+        REGISTER_COUNT(config.registerCount + config.intRegisterCount),
+        RENAME_MODE(config.renameMode),
+        PHYSICAL_REGISTER_COUNT(config.renameMode != RENAME_PRF ? 0 :
+                                config.physicalRegisters > 0 ? config.physicalRegisters : REGISTER_COUNT + ROB_SIZE),
+        MEMORY_SIZE(config.memorySize),
+        memory(config.memorySize, config.memoryFill),
+        MEMORY_ORDER(config.memoryOrder),
+        caches(config),
+        predictor(config),
+        ISSUE_WIDTH(config.issueWidth), CDB_COUNT(config.cdbCount), COMMIT_WIDTH(config.commitWidth),
+        FP_ADD_LATENCY(config.fpAddLatency), FP_MUL_LATENCY(config.fpMulLatency), FP_DIV_LATENCY(config.fpDivLatency),
+        // A roda precisa de um balde a mais que a maior latência.
+        executionWheel(WHEEL_SIZE),
+        robConsumers(ROB_SIZE), // Uma lista de consumidores por entrada do ROB.
+        stats(config.issueWidth, config.cdbCount, config.commitWidth, ROB_SIZE * THREAD_COUNT,
+              ADD_RS_COUNT, MUL_RS_COUNT, LOAD_RS_COUNT, STORE_RS_COUNT, FPADD_RS_COUNT, FPMUL_RS_COUNT),
+        SMT_POLICY(config.smtPolicy),
+        threadCommitted(THREAD_COUNT, 0), threadLastCommit(THREAD_COUNT, -1), threadBusyRS(THREAD_COUNT, 0)
+    {
+        // Dimensiona as Estações de Reserva e o ROB (no núcleo especializado, já têm o tamanho fixo).
+        sizeStorage(addRS, ADD_RS_COUNT);
+        sizeStorage(mulRS, MUL_RS_COUNT);
+        sizeStorage(loadRS, LOAD_RS_COUNT);
+        sizeStorage(storeRS, STORE_RS_COUNT);
+        sizeStorage(fpAddRS, FPADD_RS_COUNT);
+        sizeStorage(fpMulRS, FPMUL_RS_COUNT);
+        sizeStorage(rob, ROB_SIZE);
+        rebuildFreeRS();
+        resetPhysicalRegisters();
+        stats.prfOccupancy = Histogram(max(PHYSICAL_REGISTER_COUNT - REGISTER_COUNT, 0));
+
+        // Unidades funcionais padrão: uma unidade pipelined por RS que pode usá-la.
+        setFunctionalUnits(FU_ADD, ADD_RS_COUNT, true);
+        setFunctionalUnits(FU_MUL, MUL_RS_COUNT, true);
+        setFunctionalUnits(FU_DIV, MUL_RS_COUNT, true);
+        setFunctionalUnits(FU_LOAD, LOAD_RS_COUNT, true);
+        setFunctionalUnits(FU_STORE, STORE_RS_COUNT, true);
+        setFunctionalUnits(FU_FPADD, FPADD_RS_COUNT, true);
+        setFunctionalUnits(FU_FPMUL, FPMUL_RS_COUNT, true);
+        setFunctionalUnits(FU_FPDIV, FPMUL_RS_COUNT, true);
+        for (size_t i = 0; i < config.functionalUnits.size(); ++i) { // Unidades da descrição da máquina.
+            const MachineConfig::FunctionalUnitConfig &fu = config.functionalUnits[i];
+            setFunctionalUnits(fu.type, fu.count, fu.pipelined, fu.issueInterval);
+        }
+
+        // Configurações iniciais do ROB e controle.
+        robHead = 0;
+        robTail = 0;
+        robEntriesAvailable = ROB_SIZE; // ROB começa vazio.
+        fetchWindow.resize(FETCH_WINDOW_SIZE); // Instruções em voo e a próxima a ser emitida.
+
+        // A memória começa com valores previsíveis (memory[i] = i, ou zero com memory.fill = zero);
+        // as páginas só são alocadas quando escritas.
+
+        // Reseta contadores de simulação.
+        cycle = 0;
+        nextInstructionIndex = 0;
+
+        // SMT: as demais threads começam com o mesmo estado inicial da thread 0 (registradores,
+        // memória e preditor), mas cada uma com a sua cópia.
+        if (THREAD_COUNT > 1) {
+            threads.resize(THREAD_COUNT);
+            for (int t = 1; t < THREAD_COUNT; ++t) {
+                visitThreadState(threads[t], CopyField());
+                threads[t].activeProgram = nullptr;
+                threads[t].predictorHistory = predictor.getHistory();
+            }
+        }
+
+        ostringstream description;
+        writeMachineConfig(description, config);
+        machineText = description.str();
+    }
+
+    // Atalho com os tamanhos mais usados; os demais parâmetros ficam com o padrão de MachineConfig.
+    // (Em um núcleo especializado, os tamanhos de RS/ROB da forma prevalecem.)
+    TomasuloSimulatorCore(int addRSCount = 3, int mulRSCount = 2, int loadRSCount = 3, int storeRSCount = 3, int rob_s = 16,
+                      int issueWidth = 1, int cdbCount = 1, int commitWidth = 1, int registerCount = 32) :
+        TomasuloSimulatorCore(configFor(addRSCount, mulRSCount, loadRSCount, storeRSCount, rob_s,
+                                    issueWidth, cdbCount, commitWidth, registerCount)) {}
+
+    static MachineConfig configFor(int addRSCount, int mulRSCount, int loadRSCount, int storeRSCount, int robSize,
+                                   int issueWidth, int cdbCount, int commitWidth, int registerCount) {
+        MachineConfig config;
+        config.addRS = addRSCount; config.mulRS = mulRSCount; config.loadRS = loadRSCount; config.storeRS = storeRSCount;
+        config.robSize = robSize;
+        config.issueWidth = issueWidth; config.cdbCount = cdbCount; config.commitWidth = commitWidth;
+        config.registerCount = registerCount;
+        return config;
+    }
+
+    // Configura as unidades funcionais de um tipo: quantidade, se são pipelined e o
+    // intervalo (em ciclos) entre operações iniciadas na mesma unidade pipelined.
+    // Deve ser chamado antes do início da simulação.
+    void setFunctionalUnits(FUType type, int count, bool pipelined, int issueInterval = 1) {
+        FunctionalUnitPool &pool = fuPools[type];
+        pool.pipelined = pipelined;
+        pool.issueInterval = max(issueInterval, 1);
+        pool.nextFreeCycle.assign(max(count, 0), 0);
+    }
+
+    // Converte o nome de um registrador ("F12", "R3") em seu índice no banco (12; os R depois dos F).
+    // Retorna -1 se o nome não for um registrador válido nesta configuração.
+    int parseRegister(const string &name) const {
+        int code = parseRegisterName(name, FP_REGISTER_COUNT, REGISTER_COUNT - FP_REGISTER_COUNT);
+        return code < 0 ? -1 : registerIndex(static_cast<uint16_t>(code), FP_REGISTER_COUNT);
+    }
+
+    // Número na instrução do registrador de índice 'reg' no banco (o inverso de registerIndex).
+    int registerCode(int reg) const { return reg < FP_REGISTER_COUNT ? reg : INT_REGISTER_BIT + (reg - FP_REGISTER_COUNT); }
+
+    // Nome do registrador a partir do seu índice no banco (12 -> "F12").
+    string registerName(int reg) const { return registerNameOf(registerCode(reg)); }
+
+    // O registrador de índice 'reg' guarda um double? Só os F, e só com registers.int > 0
+    // (sem os R, os F são os registradores inteiros do modelo original).
+    bool holdsDouble(int reg) const { return REGISTER_COUNT > FP_REGISTER_COUNT && reg >= 0 && reg < FP_REGISTER_COUNT; }
+
+    // Valor do registrador de índice 'reg' em texto (inteiro ou double, conforme a classe).
+    string registerValueText(int reg, Word value) const { return wordText(value, holdsDouble(reg)); }
+
+    // O dado de um STORE é um double (vem de um registrador F)?
+    bool storesDouble(const DecodedInstruction &inst) const { return holdsDouble(registerIndex(inst.src1, FP_REGISTER_COUNT)); }
+
+    // Texto da instrução decodificada (ex: "ADD F1,F2,F3", "LOAD F1,100(F2)").
+    static string instructionText(const DecodedInstruction &inst) { return decodedInstructionText(inst); }
+
+    // Carrega todas as instruções de um arquivo: binário (gerado por saveProgram) ou texto.
+    // Retorna true se bem-sucedido, false caso contrário.
+    bool loadInstructions(const string &filename) {
+        if (Program::isBinaryFile(filename)) return loadBinaryProgram(filename);
+        if (!program.loadText(filename, FP_REGISTER_COUNT, REGISTER_COUNT - FP_REGISTER_COUNT, *err)) return false;
+        fetchNextInstruction();
+        return true; // Carregamento bem-sucedido.
+    }
+
+    // Abre um arquivo de texto para leitura sob demanda: as instruções são decodificadas
+    // à medida que são buscadas, e só as instruções em voo ficam na memória.
+    // Arquivos binários já são mapeados em memória e seguem o caminho de loadInstructions(),
+    // assim como programas com desvios (a busca precisa voltar a instruções já lidas).
+    // Com SMT o programa é sempre carregado inteiro (as outras threads podem usá-lo).
+    bool openInstructionStream(const string &filename) {
+        if (THREAD_COUNT > 1 || Program::isBinaryFile(filename) || Program::textHasControlFlow(filename)) return loadInstructions(filename);
+        streamFile.open(filename.c_str());
+        if (!streamFile.is_open()) {
+            *err << "Erro ao abrir arquivo: " << filename << endl;
+            return false;
+        }
+        streaming = true;
+        streamFilename = filename;
+        fetchNextInstruction();
+        return true;
+    }
+
+    // Carrega um programa no formato binário. Os registros são usados direto do arquivo
+    // mapeado; apenas o opcode e os registradores são validados para esta configuração.
+    bool loadBinaryProgram(const string &filename) {
+        if (!readBinaryProgram(program, filename)) return false;
+        fetchNextInstruction();
+        return true;
+    }
+
+    // SMT: carrega o programa próprio da thread 'thread' (1..threads-1), binário ou texto, como
+    // loadInstructions(). Uma thread sem programa próprio executa o programa da thread 0 (com os
+    // seus registradores e a sua memória). Deve ser chamada antes do início da simulação.
+    bool loadThreadInstructions(int thread, const string &filename) {
+        if (thread < 1 || thread >= THREAD_COUNT) {
+            *err << "Erro: thread " << thread << " inexistente (smt.threads = " << THREAD_COUNT << ")" << endl;
+            return false;
+        }
+        if (threadsStarted) {
+            *err << "Erro: o programa de uma thread so pode ser carregado antes do inicio da simulacao" << endl;
+            return false;
+        }
+        threadPrograms.emplace_back();
+        Program &target = threadPrograms.back();
+        if (Program::isBinaryFile(filename) ? !readBinaryProgram(target, filename) : !target.loadText(filename, FP_REGISTER_COUNT, REGISTER_COUNT - FP_REGISTER_COUNT, *err)) return false;
+        threads[thread].activeProgram = &target;
+        return true;
+    }
+
+    // Carrega o programa a partir do texto das instruções (mesmo formato do arquivo .txt),
+    // para quem monta o programa em memória em vez de ler um arquivo.
+    bool loadProgramText(const string &source) {
+        istringstream input(source);
+        if (!program.readText(input, "<programa>", FP_REGISTER_COUNT, REGISTER_COUNT - FP_REGISTER_COUNT, *err)) return false;
+        fetchNextInstruction();
+        return true;
+    }
+
+    // Usa um programa já carregado, sem copiá-lo (ex: o mesmo programa compartilhado,
+    // somente leitura, por várias instâncias em uma varredura). 'shared' deve existir
+    // enquanto o simulador for usado.
+    bool useProgram(const Program &shared) {
+        long long invalid = shared.findInvalidInstruction(FP_REGISTER_COUNT, REGISTER_COUNT - FP_REGISTER_COUNT);
+        if (invalid >= 0) {
+            *err << "Instrucao invalida para " << FP_REGISTER_COUNT << " registradores F e " << REGISTER_COUNT - FP_REGISTER_COUNT
+                 << " R no indice " << invalid << endl;
+            return false;
+        }
+        activeProgram = &shared;
+        fetchNextInstruction();
+        return true;
+    }
+
+    // Escreve a imagem inicial na memória. Deve ser chamada antes do início da simulação.
+    // Com SMT, vale para a memória de todas as threads.
+    bool loadMemoryImage(const MemoryImage &image) {
+        for (size_t i = 0; i < image.words.size(); ++i) {
+            const MemoryImage::Entry &word = image.words[i];
+            if (!memory.contains(word.address)) {
+                *err << image.path << ":" << word.line << ": endereco " << word.address << " fora da memoria ("
+                     << MEMORY_SIZE << " palavras)" << endl;
+                return false;
+            }
+            memory.write(word.address, word.value);
+            for (int t = 1; t < THREAD_COUNT; ++t) threads[t].memory.write(word.address, word.value); // A ativa é a 0.
+        }
+        return true;
+    }
+
+    // Modo funcional (fast-forward): executa as próximas 'count' instruções só sobre o estado
+    // arquitetural (registradores e memória), sem RS, ROB nem CDB, com a mesma semântica do
+    // WriteResult e do Commit. Os desvios seguem a direção real. Os caches e o preditor são
+    // aquecidos (linhas, LRU, contadores e histórico), sem tempo nem estatísticas. Depois, o
+    // pipeline detalhado continua da instrução seguinte, no ciclo 0, com os índices dinâmicos a
+    // partir de 'count'. Deve ser chamada logo depois de carregar o programa (e a imagem da memória).
+    // Retorna as instruções executadas (menos que 'count' se o programa acabar antes).
+    int fastForward(int count) {
+        if (!singleThreadOnly("o modo funcional")) return 0;
+        if (cycle != 0 || nextInstructionIndex != committedCount) {
+            *err << "Erro: o modo funcional so pode ser usado antes do inicio da simulacao" << endl;
+            return 0;
+        }
+        if (count <= 0) return 0;
+        int executed = 0;
+        DecodedInstruction inst;
+        int pc, address;
+        unsigned historyBefore;
+        while (executed < count && takeFunctionalInstruction(inst, pc, historyBefore)) {
+            fetchPC = executeFunctional(inst, pc, historyBefore, committedCount + executed, address);
+            executed++;
+        }
+        handOffToPipeline(executed);
+        stats.fastForwarded += executed;
+        return executed;
+    }
+
+    // Análise do fluxo de dados (ver DataflowReport) das próximas 'count' instruções (todas, se
+    // count < 0), executadas no modo funcional. Como fastForward(), deve ser chamada antes do início
+    // da simulação; o estado avança como no modo funcional. Guarda ~28 bytes por instrução analisada
+    // (o produtor crítico, o fim e a instrução), para reconstruir a cadeia crítica no fim.
+    DataflowReport analyzeDataflow(long long count = -1) {
+        DataflowReport report;
+        if (!singleThreadOnly("a analise do fluxo de dados")) return report;
+        if (cycle != 0 || nextInstructionIndex != committedCount) {
+            *err << "Erro: a analise do fluxo de dados so pode ser usada antes do inicio da simulacao" << endl;
+            return report;
+        }
+        // Latência de cada instrução no caminho crítico: a do pipeline; LOADs com acerto no L1. O J
+        // fica pronto na emissão e o STORE não atrasa o LOAD seguinte (o dado é encaminhado a ele).
+        auto latency = [&](InstructionType type) {
+            if (type == JUMP || type == STORE) return 0;
+            if (type == LOAD && caches.enabled()) return max(caches.hitLatency(), 1);
+            return max(latencyOf(type), 1);
+        };
+        vector<long long> registerReady(REGISTER_COUNT, 0); // Fim do último produtor de cada registrador.
+        vector<int> registerProducer(REGISTER_COUNT, -1);
+        unordered_map<int, pair<long long, int>> storeReady;  // Endereço -> fim e índice do último STORE.
+        vector<int> criticalProducer, positions;            // Por instrução (a partir de 'first').
+        vector<long long> endCycles;
+        vector<DecodedInstruction> executedInstructions;
+        int first = committedCount, executed = 0;
+        int lastInstruction = -1;
+        DecodedInstruction inst;
+        int pc, address;
+        unsigned historyBefore;
+        while ((count < 0 || executed < count) && takeFunctionalInstruction(inst, pc, historyBefore)) {
+            int index = first + executed;
+            fetchPC = executeFunctional(inst, pc, historyBefore, index, address);
+            // Produtores: as mesmas fontes que issueInstruction() lê (LOAD só usa a base).
+            long long start = 0;
+            int producer = -1;
+            auto dependOn = [&](long long ready, int from) { if (from >= 0 && ready > start) { start = ready; producer = from; } };
+            const int src1 = registerIndex(inst.src1, FP_REGISTER_COUNT), src2 = registerIndex(inst.src2, FP_REGISTER_COUNT);
+            if (inst.type() != LOAD && inst.type() != JUMP && src1 >= 0) dependOn(registerReady[src1], registerProducer[src1]);
+            if (inst.type() != JUMP && src2 >= 0) dependOn(registerReady[src2], registerProducer[src2]);
+            if (inst.type() == LOAD && address >= 0 && MEMORY_ORDER != MEMORY_ORDER_NONE) { // Em "none", o LOAD não espera STOREs.
+                unordered_map<int, pair<long long, int>>::const_iterator store = storeReady.find(address);
+                if (store != storeReady.end()) { report.memoryEdges++; dependOn(store->second.first, store->second.second); }
+            }
+            long long end = start + latency(inst.type());
+            const int dest = registerIndex(inst.dest, FP_REGISTER_COUNT);
+            if (dest >= 0) { registerReady[dest] = end; registerProducer[dest] = index; }
+            if (inst.type() == STORE && address >= 0) storeReady[address] = make_pair(end, index);
+            criticalProducer.push_back(producer);
+            positions.push_back(pc);
+            executedInstructions.push_back(inst);
+            endCycles.push_back(end);
+            if (end > report.criticalPathCycles || lastInstruction < 0) { report.criticalPathCycles = end; lastInstruction = index; }
+            executed++;
+        }
+        handOffToPipeline(executed);
+        report.instructions = executed;
+
+        // Cadeia crítica: do último a terminar, de produtor em produtor.
+        vector<int> chain;
+        for (int index = lastInstruction; index >= 0; index = criticalProducer[index - first]) chain.push_back(index);
+        reverse(chain.begin(), chain.end());
+        report.chainLength = static_cast<long long>(chain.size());
+        const int SHOWN = 8; // Instruções listadas no início e no fim da cadeia.
+        for (size_t i = 0; i < chain.size(); ++i) {
+            int offset = chain[i] - first;
+            DataflowChainEntry entry;
+            entry.instructionIndex = chain[i];
+            entry.pc = positions[offset];
+            entry.decoded = executedInstructions[offset];
+            entry.end = endCycles[offset];
+            entry.start = i > 0 ? endCycles[chain[i - 1] - first] : 0;
+            report.chainOps[entry.decoded.type()]++;
+            report.chainCycles[entry.decoded.type()] += entry.end - entry.start;
+            if (static_cast<int>(i) < SHOWN) report.chainHead.push_back(entry);
+            else if (chain.size() > 2 * SHOWN && i + SHOWN >= chain.size()) report.chainTail.push_back(entry);
+            else if (chain.size() <= 2 * SHOWN) report.chainHead.push_back(entry);
+        }
+        return report;
+    }
+
+    // Grava o programa carregado no formato binário (para carregar mais rápido depois).
+    bool saveProgram(const string &filename) const {
+        if (!activeProgram->saveBinary(filename)) {
+            *err << "Erro ao gravar programa binario: " << filename << endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Verifica se a simulação chegou ao fim.
+    // Condições: todas as instruções emitidas, ROB vazio, nenhuma instrução executando ou na fila do CDB.
+    bool isSimulationComplete() const {
+        if (cosimDiverged) return true; // Interrompida pela co-simulação (ver hasDiverged()).
+        // Ainda há instruções do programa para serem emitidas?
+        if (nextInstructionIndex < fetchedCount || !sourceExhausted) return false;
+        // O ROB não está completamente vazio (ou seja, nem todas as entradas estão disponíveis)?
+        if (robEntriesAvailable != ROB_SIZE) return false;
+        // Ainda há instruções em unidades funcionais ou aguardando o CDB para escrever?
+        if (executingCount != 0 || !completedForCDB.empty()) return false;
+        // Com SMT, as outras threads também terminaram (e já começaram).
+        if (THREAD_COUNT > 1) {
+            if (!threadsStarted) return false;
+            for (int t = 0; t < THREAD_COUNT; ++t) if (t != activeThread && !threadFinished(threads[t], ROB_SIZE)) return false;
+        }
+        // Todas as instruções buscadas foram cometidas (as condições acima já implicam isso).
+        return committedCount == fetchedCount;
+    }
+
+    // Avança até 'cycles' ciclos, ou até o fim do programa, pulando os ciclos em que nada pode
+    // acontecer (os resultados são os mesmos do ciclo a ciclo). Retorna os ciclos avançados.
+    int runCycles(int cycles) {
+        int start = cycle;
+        int end = cycles >= numeric_limits<int>::max() - cycle ? numeric_limits<int>::max() : cycle + cycles;
+        while (!isSimulationComplete() && cycle < end) {
+            stepSimulation();
+            skipIdleCycles(end);
+        }
+        return cycle - start;
+    }
+
+    // Simula até o fim do programa. Retorna o total de ciclos.
+    int runToCompletion() {
+        runCycles(numeric_limits<int>::max());
+        return cycle;
+    }
+
+    // Pula os ciclos em que nada pode acontecer (ex: só resta esperar um DIV de 40 ciclos),
+    // levando 'cycle' direto ao próximo evento, mas nunca além de 'limitCycle'.
+    // Os ciclos de issue/execComp/writeResult/commit das instruções são os mesmos da
+    // simulação ciclo a ciclo. Retorna quantos ciclos foram pulados.
+    int skipIdleCycles(int limitCycle = numeric_limits<int>::max()) {
+        int target = min(nextEventCycle(), limitCycle);
+        if (target <= cycle) return 0;
+        int skipped = target - cycle;
+        // Nos ciclos pulados nenhum estágio processou instruções, o estado (ocupação, motivo
+        // da parada do Issue) não mudou e as RSs prontas continuaram esperando pelo mesmo
+        // motivo: unidade funcional, MSHR ou, os LOADs, STOREs mais antigos.
+        stats.issueWidth.perCycle[0] += skipped;
+        stats.cdbWidth.perCycle[0] += skipped;
+        stats.commitWidth.perCycle[0] += skipped;
+        recordSkippedIssueStalls(skipped);
+        stats.cdbQueueDepth.add(0, skipped);
+        sampleOccupancy(skipped);
+        int current = activeThread;
+        for (int g = 0; g < RS_GROUP_COUNT; ++g) {
+            for (size_t k = 0; k < readyRS[g].size(); ++k) {
+                const ReservationStation &rs = stationAt(static_cast<RSGroup>(g), readyRS[g][k]);
+                selectThread(rs.thread);
+                int blockedLevel = -1;
+                switch (readyBlockCause(rs, blockedLevel)) {
+                    case READY_WAIT_STORE: stats.memoryWaitCycles += skipped; break;
+                    case READY_WAIT_UNIT: fuPools[functionalUnitFor(rs.op)].stallCycles += skipped; break;
+                    case READY_WAIT_MSHR: caches.recordMshrStall(blockedLevel, skipped); break;
+                    case READY_CAN_START: break; // Não ocorre: haveria um evento no ciclo atual.
+                }
+            }
+        }
+        selectThread(current);
+        cycle = target; // Só depois de classificar as esperas, que dependem do ciclo atual.
+        return skipped;
+    }
+
+    // Avança um ciclo da simulação, executando as fases do pipeline na ordem correta.
+    // A ordem é importante para o fluxo de dados e controle.
+    void stepSimulation() {
+        if (THREAD_COUNT > 1 && !threadsStarted) startThreads();
+        if (stageProfile) stageStart = chrono::steady_clock::now();
+
+        // 1. Commit: Tenta cometer até COMMIT_WIDTH instruções da cabeça do ROB, em ordem.
+        //    Isso libera entradas do ROB e atualiza o estado arquitetural.
+        //    Deve vir antes do Issue para que o Issue possa usar entradas do ROB recém-liberadas.
+        //    Com SMT, a largura é dividida entre as threads, a partir de uma que avança a cada ciclo.
+        int committed = 0;
+        bool commitSaturated = false; // Parou pela largura com instruções ainda prontas?
+        for (int k = 0; k < THREAD_COUNT; ++k) {
+            selectThread(THREAD_COUNT == 1 ? 0 : (cycle + k) % THREAD_COUNT);
+            while (committed < COMMIT_WIDTH && commitInstruction()) committed++;
+            if (committed == COMMIT_WIDTH && canCommit()) commitSaturated = true;
+        }
+        stats.commitWidth.record(committed, commitSaturated);
+        if (stageProfile) endStage(STAGE_COMMIT);
+
+        // 2. WriteResult (CDB->ROB): Até CDB_COUNT resultados das UFs são escritos no ROB
+        //    e transmitidos via CDB para RSs dependentes.
+        //    Libera RSs e disponibiliza operandos. Deve vir antes do Execute/Issue
+        //    para que instruções possam começar a executar ou ser emitidas com operandos atualizados.
+        stats.cdbQueueDepth.add(static_cast<int>(completedForCDB.size()));
+        int written = 0;
+        while (written < CDB_COUNT && processWriteBack()) written++;
+        stats.cdbWidth.record(written, !completedForCDB.empty());
+        // Um desvio mal previsto descarta o caminho errado; um STORE que descobriu o seu endereço
+        // pode ter invalidado um LOAD especulativo. Se os dois ocorrem, vale o descarte mais antigo
+        // (uma reexecução que inclui o desvio o executa de novo, e a previsão errada reaparece).
+        // Com SMT, cada thread descarta só as suas instruções.
+        for (int t = 0; t < THREAD_COUNT; ++t) {
+            selectThread(t);
+            if (mispredictedBranch >= 0 && (replayFrom < 0 || mispredictedBranch < replayFrom)) {
+                recoverFromMisprediction(mispredictedBranch);
+            } else if (replayFrom >= 0) {
+                stats.squashedInstructions += squashFrom(replayFrom);
+                stats.memoryReplays++;
+            }
+            mispredictedBranch = -1;
+            replayFrom = -1;
+        }
+        if (stageProfile) endStage(STAGE_WRITEBACK);
+
+        // 3. Issue: Até ISSUE_WIDTH novas instruções são alocadas no ROB e nas RSs, em ordem.
+        //    Pode usar recursos (ROB, tags) que foram atualizados/liberados
+        //    pelas fases de Commit e WriteResult deste ciclo.
+        //    Com SMT, as threads emitem na ordem de smt.policy: cada uma até parar, e a largura
+        //    que sobra passa para a seguinte.
+        int issued = 0;
+        // Motivo que impediu a próxima emissão (ISSUE_OK se parou só pela largura). Com SMT, o da
+        // primeira thread (na ordem do ciclo) que tinha instrução para emitir.
+        IssueStallCause stallCause = STALL_NO_INSTRUCTION;
+        if (THREAD_COUNT > 1) orderThreadsForIssue(cycle);
+        for (int k = 0; k < THREAD_COUNT; ++k) {
+            if (THREAD_COUNT > 1) selectThread(threadOrder[k]);
+            while (issued < ISSUE_WIDTH && issueInstruction()) issued++;
+            IssueStallCause cause = issueBlockCause();
+            if (issued == ISSUE_WIDTH) { stallCause = cause; break; }
+            if (stallCause == STALL_NO_INSTRUCTION) stallCause = cause;
+        }
+        stats.issueWidth.record(issued, issued == ISSUE_WIDTH && stallCause == ISSUE_OK);
+        if (issued < ISSUE_WIDTH) stats.issueStallCycles[stallCause]++;
+        if (stageProfile) endStage(STAGE_ISSUE);
+
+        // 4. Execute (Start & Advance): Instruções com operandos prontos
+        //    (potencialmente devido ao WriteResult deste mesmo ciclo)
+        //    iniciam ou continuam sua execução. O estado no ROB é atualizado para EXECUTE.
+        startExecution();   // Verifica RSs prontas e as move para a lista de execução.
+        advanceExecution(); // Decrementa contadores das instruções em execução.
+        selectThread(0);
+        if (stageProfile) endStage(STAGE_EXECUTE);
+
+        sampleOccupancy(1);
+
+        cycle++; // Avança o contador de ciclo global.
+    }
+
+    // Perfil por estágio: soma o tempo desde o fim do estágio anterior e recomeça a contagem.
+    void endStage(PipelineStage stage) {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        stageProfile->seconds[stage] += chrono::duration<double>(now - stageStart).count();
+        stageStart = now;
+    }
+
+    // Retorna o ciclo atual da simulação.
+    int getCurrentCycle() const { return cycle; }
+
+    // Retorna o número de instruções carregadas do programa.
+    // Instruções do programa. No modo streaming, só as já lidas (o total é conhecido ao fim).
+    int getInstructionCount() const { return streaming ? fetchedCount : static_cast<int>(activeProgram->size()); }
+    void setKeepHistory(bool enabled) { keepHistory = enabled; } // Desligado: memória limitada às instruções em voo.
+
+    // Liga/desliga a linha de log impressa a cada commit.
+    void setCommitLog(bool enabled) { commitLogEnabled = enabled; }
+    // Eventos do pipeline (ex: um TraceWriter). nullptr desliga. Não é dono do objeto.
+    // Com SMT, recusa (retorna false): os índices de instrução e de ROB dos eventos são por
+    // thread, e o TraceRecord não diz a thread.
+    bool setListener(PipelineListener *eventListener) {
+        if (eventListener != nullptr && !singleThreadOnly("o listener de eventos (trace)")) return false;
+        listener = eventListener;
+        return true;
+    }
+    // Acumula em 'profile' o tempo real de cada estágio de stepSimulation() (ver StageProfile).
+    // nullptr desliga. Não é dono do objeto.
+    void setStageProfile(StageProfile *profile) { stageProfile = profile; }
+    // Redireciona as impressões (tabelas, log de commits, estatísticas) e as mensagens de erro.
+    void setOutput(ostream &output, ostream &errors) { out = &output; err = &errors; }
+
+    // Estatísticas coletadas até o momento.
+    const SimulatorStats &getStats() const { return stats; }
+
+    // Liga a co-simulação: cada commit passa a ser conferido com um modelo de referência em
+    // ordem (ReferenceModel), que parte do estado arquitetural atual (registradores, memória e a
+    // próxima instrução a cometer). fastForward() e restoreSnapshot() sincronizam o modelo de novo.
+    // Na primeira divergência o contexto vai para 'err' e a simulação para: isSimulationComplete()
+    // passa a ser true e hasDiverged() indica o motivo. O custo é um passo do modelo por commit.
+    // Com SMT, não faz nada (ver singleThreadOnly).
+    void enableCosimulation() {
+        if (!singleThreadOnly("a co-simulacao")) return;
+        cosimEnabled = true;
+        cosimDiverged = false;
+        cosimChecked = 0;
+        reference = referenceModel();
+    }
+    // Modelo de referência sobre o estado arquitetural atual, a partir da próxima instrução a cometer.
+    ReferenceModel referenceModel() const {
+        return ReferenceModel(registers, FP_REGISTER_COUNT, memory, fetchedCount > committedCount ? inFlight(committedCount).pc : fetchPC);
+    }
+    bool hasDiverged() const { return cosimDiverged; }
+    long long getCosimChecked() const { return cosimChecked; } // Commits conferidos sem divergência.
+
+    // Snapshot do estado completo, entre dois ciclos: o cabeçalho com a descrição da máquina
+    // e todo o estado da simulação (ver transferState). Só com uma thread (ver saveSnapshot).
+    string snapshotData() {
+        SnapshotWriter writer;
+        writer.header(machineText);
+        transferState(writer);
+        return writer.data();
+    }
+
+    // Grava o snapshot em um arquivo. Escreve em um arquivo temporário e renomeia, então um
+    // checkpoint anterior com o mesmo nome só é substituído por um completo.
+    bool saveSnapshot(const string &path) {
+        if (!singleThreadOnly("o snapshot")) return false;
+        string data = snapshotData();
+        string temporary = path + ".tmp";
+        {
+            ofstream file(temporary.c_str(), ios::binary | ios::trunc);
+            if (!file.is_open() || !file.write(data.data(), data.size())) {
+                *err << "Erro ao gravar snapshot: " << temporary << endl;
+                return false;
+            }
+        }
+        if (rename(temporary.c_str(), path.c_str()) != 0) {
+            *err << "Erro ao gravar snapshot: " << path << endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Restaura um snapshot (de snapshotData ou de um arquivo) depois de carregar o programa.
+    // A máquina deve ter a mesma forma (tamanhos) da que gravou; a descrição do cabeçalho não
+    // é aplicada aqui (ver --restore). Em caso de erro, o estado do simulador fica inválido.
+    bool restoreSnapshot(const string &data) {
+        if (!singleThreadOnly("o snapshot")) return false;
+        SnapshotReader reader(data);
+        string savedMachine;
+        if (reader.header(savedMachine)) transferState(reader);
+        if (reader.ok() && reader.remaining() != 0) reader.fail("dados a mais no fim");
+        if (!reader.ok()) {
+            *err << "Snapshot invalido: " << reader.getError() << endl;
+            return false;
+        }
+        if (cosimEnabled) enableCosimulation(); // O modelo de referência parte do estado restaurado.
+        return true;
+    }
+
+    // Instruções por ciclo até o momento.
+    double getIPC() const { return cycle > 0 ? static_cast<double>(stats.committedInstructions) / cycle : 0.0; }
+
+    // SMT: quantidade de threads e, por thread, instruções cometidas, IPC (sobre o total de ciclos)
+    // e ciclo do último commit (-1: nenhum; só registrado com SMT).
+    int getThreadCount() const { return THREAD_COUNT; }
+    long long getThreadCommitted(int thread) const { return THREAD_COUNT > 1 ? threadCommitted[thread] : stats.committedInstructions; }
+    double getThreadIPC(int thread) const { return cycle > 0 ? static_cast<double>(getThreadCommitted(thread)) / cycle : 0.0; }
+    int getThreadLastCommit(int thread) const { return threadLastCommit[thread]; }
+
+    // Imprime o relatório de estatísticas: IPC, paradas do Issue por motivo, ocupação
+    // do ROB/RSs e do CDB, espera por operandos, largura dos estágios e unidades funcionais.
+    void printStatistics() const {
+        *out << "\nEstatisticas:\n";
+        *out << "  Ciclos: " << cycle << "\n";
+        *out << "  Instrucoes cometidas: " << stats.committedInstructions << "\n";
+        printFormatted("  IPC: %.4f\n", getIPC());
+        if (THREAD_COUNT > 1) {
+            *out << "  Threads: " << THREAD_COUNT << " (smt.policy = " << smtPolicyName(SMT_POLICY) << ")\n";
+            for (int t = 0; t < THREAD_COUNT; ++t) {
+                printFormatted("    T%d: %lld instrucoes, IPC %.4f, ultimo commit no ciclo %d\n", t, threadCommitted[t], getThreadIPC(t), threadLastCommit[t]);
+            }
+        }
+        if (stats.fastForwarded > 0) *out << "  Instrucoes no modo funcional (antes do ciclo 0): " << stats.fastForwarded << "\n";
+        if (cosimEnabled) {
+            *out << "  Co-simulacao: " << cosimChecked << " commits conferidos com o modelo de referencia"
+                 << (cosimDiverged ? " (interrompida na divergencia)" : ", sem divergencias") << "\n";
+        }
+        size_t pages = memory.pageCount(); // Com SMT, somadas as memórias das threads.
+        for (size_t t = 0; t < threads.size(); ++t) if (static_cast<int>(t) != activeThread) pages += threads[t].memory.pageCount();
+        *out << "  Paginas de memoria alocadas: " << pages << " paginas de " << SparseMemory::PAGE_WORDS << " palavras ("
+             << pages * SparseMemory::PAGE_WORDS << " palavras)\n";
+
+        *out << "\nParadas do Issue (ciclos):\n";
+        static const char *causeNames[ISSUE_STALL_CAUSE_COUNT] = {
+            "", "Sem instrucoes", "ROB cheio", "RS ADD/SUB cheia", "RS MUL/DIV cheia", "RS LOAD cheia", "RS STORE cheia",
+            "RS ADD.D cheia", "RS MUL.D cheia", "PRF cheio"};
+        const bool typedRegisters = REGISTER_COUNT > FP_REGISTER_COUNT; // Só então há operações de ponto flutuante.
+        for (int c = STALL_NO_INSTRUCTION; c < ISSUE_STALL_CAUSE_COUNT; ++c) {
+            if (c == STALL_PRF_FULL && RENAME_MODE != RENAME_PRF) continue;
+            if ((c == STALL_RS_FPADD_FULL || c == STALL_RS_FPMUL_FULL) && !typedRegisters) continue;
+            printFormatted("  %-18s %lld\n", causeNames[c], stats.issueStallCycles[c]);
+        }
+
+        *out << "\nOcupacao e Espera:\n";
+        printFormatted("  %-22s | %-8s | %-5s | %-5s | %-5s\n", "Medida", "Media", "p50", "p90", "Max");
+        auto printHistogram = [this](const char *name, const Histogram &h) {
+            printFormatted("  %-22s | %-8.3f | %-5d | %-5d | %-5d\n", name, h.mean(), h.percentile(0.5), h.percentile(0.9), h.maxValue);
+        };
+        printHistogram("Ocupacao do ROB", stats.robOccupancy);
+        printHistogram("Ocupacao RS ADD/SUB", stats.rsOccupancy[RS_ADD]);
+        printHistogram("Ocupacao RS MUL/DIV", stats.rsOccupancy[RS_MUL]);
+        printHistogram("Ocupacao RS LOAD", stats.rsOccupancy[RS_LOAD]);
+        printHistogram("Ocupacao RS STORE", stats.rsOccupancy[RS_STORE]);
+        if (typedRegisters) {
+            printHistogram("Ocupacao RS ADD.D", stats.rsOccupancy[RS_FPADD]);
+            printHistogram("Ocupacao RS MUL.D", stats.rsOccupancy[RS_FPMUL]);
+        }
+        if (RENAME_MODE == RENAME_PRF) printHistogram("Fisicos em uso", stats.prfOccupancy);
+        printHistogram("Fila do CDB", stats.cdbQueueDepth);
+        printHistogram("Espera por operandos", stats.operandWait);
+        printHistogram("Espera em Qj", stats.qjWait);
+        printHistogram("Espera em Qk", stats.qkWait);
+
+        if (MEMORY_ORDER != MEMORY_ORDER_NONE) {
+            *out << "\nFila de LOADs/STOREs (memory_order = " << memoryOrderName(MEMORY_ORDER) << "):\n";
+            *out << "  LOADs encaminhados de STOREs: " << stats.forwardedLoads << "\n";
+            *out << "  LOADs especulativos: " << stats.speculativeLoads << "\n";
+            *out << "  Ciclos de LOADs retidos por STOREs: " << stats.memoryWaitCycles << "\n";
+            *out << "  Reexecucoes: " << stats.memoryReplays << " (" << stats.squashedInstructions << " instrucoes descartadas)\n";
+        }
+
+        if (stats.branches + stats.jumps > 0) {
+            *out << "\nDesvios (branch.predictor = " << branchPredictorName(predictor.getKind()) << "):\n";
+            *out << "  Desvios condicionais: " << stats.branches << " (" << stats.takenBranches << " tomados)\n";
+            *out << "  Saltos: " << stats.jumps << "\n";
+            *out << "  Previsoes erradas: " << stats.mispredictions;
+            if (stats.branches > 0) printFormatted(" (acerto %.2f%%)", 100.0 * (stats.branches - stats.mispredictions) / stats.branches);
+            *out << "\n  Instrucoes do caminho errado descartadas: " << stats.wrongPathInstructions << "\n";
+        }
+
+        if (caches.enabled()) printCacheStats();
+
+        printWidthStats();
+        printFunctionalUnitStats();
+    }
+
+    // Imprime, para cada estágio superescalar, com que frequência a largura foi esgotada.
+    // "Cheio" conta os ciclos que usaram toda a largura; "Limitado" os ciclos cheios em que
+    // ainda havia instruções prontas para o estágio (uma largura maior teria ajudado).
+    void printWidthStats() const {
+        *out << "\nUso da Largura por Estagio:\n";
+        printFormatted("----------------------------------------------------------------------\n");
+        printFormatted("| %-7s | %-7s | %-10s | %-10s | %-8s | %-12s |\n", "Estagio", "Largura", "Cheio", "Limitado", "Media", "Distribuicao");
+        printFormatted("----------------------------------------------------------------------\n");
+        const StageWidthStats *stages[] = {&stats.issueWidth, &stats.cdbWidth, &stats.commitWidth};
+        const char *names[] = {"Issue", "CDB", "Commit"};
+        for (int i = 0; i < 3; ++i) {
+            const StageWidthStats &st = *stages[i];
+            long long cyclesSeen = 0;
+            for (size_t k = 0; k < st.perCycle.size(); ++k) cyclesSeen += st.perCycle[k];
+            double avg = cyclesSeen > 0 ? static_cast<double>(st.total) / cyclesSeen : 0.0;
+            string dist; // Ciclos com 0, 1, ..., largura instruções processadas.
+            for (size_t k = 0; k < st.perCycle.size(); ++k) dist += (k ? "/" : "") + to_string(st.perCycle[k]);
+            printFormatted("| %-7s | %-7d | %-10lld | %-10lld | %-8.3f | %s\n", names[i], static_cast<int>(st.perCycle.size()) - 1,
+                st.fullCycles, st.limitedCycles, avg, dist.c_str());
+        }
+        printFormatted("----------------------------------------------------------------------\n");
+    }
+
+    // Imprime a geometria e os contadores de cada nível de cache. "Mescladas" são acessos a
+    // linhas que ainda estavam chegando; "Espera MSHR" soma, por ciclo, os acessos prontos
+    // que não começaram por falta de MSHR livre no nível.
+    void printCacheStats() const {
+        *out << "\nCaches:\n";
+        printFormatted("----------------------------------------------------------------------------------------------------\n");
+        printFormatted("| %-5s | %-7s | %-4s | %-5s | %-8s | %-5s | %-9s | %-9s | %-9s | %-9s | %-11s |\n",
+            "Nivel", "Tamanho", "Vias", "Linha", "Latencia", "MSHRs", "Acessos", "Acertos", "Faltas", "Mescladas", "Espera MSHR");
+        printFormatted("----------------------------------------------------------------------------------------------------\n");
+        const vector<CacheLevel> &levels = caches.getLevels();
+        for (size_t i = 0; i < levels.size(); ++i) {
+            const CacheLevel &level = levels[i];
+            printFormatted("| %-5s | %-7d | %-4d | %-5d | %-8d | %-5d | %-9lld | %-9lld | %-9lld | %-9lld | %-11lld |\n",
+                level.name, level.size, level.ways, level.lineWords, level.latency, level.mshrCount(),
+                level.stats.accesses, level.stats.hits, level.stats.misses, level.stats.merged, level.stats.mshrStalls);
+        }
+        printFormatted("----------------------------------------------------------------------------------------------------\n");
+        if (!levels.empty() && levels[0].stats.accesses > 0) {
+            printFormatted("  Taxa de acerto L1: %.2f%%\n", 100.0 * levels[0].stats.hits / levels[0].stats.accesses);
+        }
+    }
+
+    // Imprime o uso e a contenção das unidades funcionais de cada tipo.
+    // "Espera" é a soma, ciclo a ciclo, das RSs prontas que não encontraram unidade livre.
+    void printFunctionalUnitStats() const {
+        *out << "\nUnidades Funcionais:\n";
+        printFormatted("------------------------------------------------------------\n");
+        printFormatted("| %-5s | %-5s | %-9s | %-9s | %-10s | %-8s |\n", "Tipo", "Qtde", "Pipelined", "Intervalo", "Operacoes", "Espera");
+        printFormatted("------------------------------------------------------------\n");
+        for (int t = 0; t < FU_TYPE_COUNT; ++t) {
+            const FunctionalUnitPool &pool = fuPools[t];
+            if (t >= FU_FPADD && pool.operations == 0) continue; // As de ponto flutuante só aparecem quando usadas.
+            printFormatted("| %-5s | %-5zu | %-9s | %-9d | %-10lld | %-8lld |\n", functionalUnitName(static_cast<FUType>(t)),
+                pool.nextFreeCycle.size(), pool.pipelined ? "Sim" : "Nao", pool.issueInterval, pool.operations, pool.stallCycles);
+        }
+        printFormatted("------------------------------------------------------------\n");
+    }
+
+    // Imprime os valores finais dos registradores arquiteturais.
+    // Útil ao final da simulação para verificar os resultados.
+    void printRegisters() const {
+        for (int t = 0; t < THREAD_COUNT; ++t) {
+            const vector<Word> &values = t == activeThread ? registers : threads[t].registers;
+            *out << "\nValores Finais dos Registradores";
+            if (THREAD_COUNT > 1) *out << " (thread " << t << ")";
+            *out << ":\n---------------------------------\n";
+            for (int reg = 0; reg < REGISTER_COUNT; ++reg) {
+                *out << registerName(reg) << " = " << registerValueText(reg, values[reg]) << endl;
+            }
+            *out << "---------------------------------\n";
+        }
+    }
+
+    // Imprime o estado detalhado de todos os componentes do simulador.
+    // Essencial para depuração e para entender o comportamento ciclo a ciclo.
+    void printStatus() {
+        *out << "\n==== Ciclo " << cycle << " ====" << endl;
+
+        if (THREAD_COUNT > 1 && !threadsStarted) startThreads(); // As tabelas mostram o programa de cada thread.
+        for (int t = 0; t < THREAD_COUNT; ++t) { // Com SMT, uma tabela de instruções por thread.
+            selectThread(t);
+            if (THREAD_COUNT > 1) *out << "\n--- Thread " << t << " ---" << endl;
+            printInstructionTable();
+        }
+
+        // Tabela de Estações de Reserva (formato unificado para todos os tipos).
+        // Strings de formatação para consistência.
+        const char *rsTableFormat = "| %-1zu | %-4s | %-5s | %-5s | %-5s | %-7s | %-7s | %-10s | %-3s | %-7s |\n";
+        const char *rsTableHeader = "| # | Busy | Op    | Vj    | Vk    | Qj(ROB#)| Qk(ROB#)| Dest(ROB#) | A   | InstIdx |\n";
+        string rsLineSeparator =    "-------------------------------------------------------------------------------------";
+
+        // Lambda para imprimir um grupo de RSs. Evita repetição de código.
+        auto printRSGroup = [&](const string &name, const ReservationStation *rsGroup, size_t rsCount) {
+            *out << "\nEstacoes de Reserva " << name << ":" << endl << rsLineSeparator << endl << rsTableHeader << rsLineSeparator << endl;
+            for (size_t i = 0; i < rsCount; ++i) {
+                const auto &rs = rsGroup[i];
+                string opStr; // String para o tipo de operação na RS.
+                if (rs.busy) opStr = rs.op == INVALID ? "???" : instructionTypeName(rs.op);
+                // Operandos double: os das operações .D e a fonte de CVT.W.D (o dado de um STORE fica como inteiro).
+                bool doubleJ = rs.op == ADD_D || rs.op == SUB_D || rs.op == MUL_D || rs.op == DIV_D || rs.op == CVT_W_D;
+                bool doubleK = doubleJ && rs.op != CVT_W_D;
+                // Imprime os campos da RS. Mostra "-" se não aplicável ou não pronto.
+                printFormatted(rsTableFormat, i, (rs.busy ? "Sim" : "Nao"), opStr.c_str(),
+                    (rs.busy && rs.Qj == TAG_READY ? wordText(operandJ(rs), doubleJ).c_str() : "-"), // Vj só se Qj estiver pronto.
+                    (rs.busy && rs.Qk == TAG_READY ? wordText(operandK(rs), doubleK).c_str() : "-"), // Vk só se Qk estiver pronto.
+                    (rs.busy && rs.Qj != TAG_READY ? to_string(rs.Qj).c_str() : "-"), // Qj se estiver esperando.
+                    (rs.busy && rs.Qk != TAG_READY ? to_string(rs.Qk).c_str() : "-"), // Qk se estiver esperando.
+                    (rs.busy ? to_string(rs.destRobIndex).c_str() : "-"),
+                    // Campo 'A' (offset) é relevante apenas para LOAD/STORE.
+                    (rs.busy && (rs.op == LOAD || rs.op == STORE) ? to_string(rs.A).c_str() : "-"),
+                    // Com SMT, a instrução vem com a thread ("T1:4"): as tags são do ROB dela.
+                    (rs.busy && rs.instructionIndex != -1 ? ((THREAD_COUNT > 1 ? "T" + to_string(rs.thread) + ":" : string()) +
+                                                             to_string(rs.instructionIndex)).c_str() : "-"));
+            }
+            *out << rsLineSeparator << endl;
+        };
+        // Chama a lambda para cada grupo de RS.
+        printRSGroup("ADD/SUB", addRS.data(), addRS.size()); printRSGroup("MUL/DIV", mulRS.data(), mulRS.size());
+        printRSGroup("LOAD", loadRS.data(), loadRS.size()); printRSGroup("STORE", storeRS.data(), storeRS.size());
+        if (REGISTER_COUNT > FP_REGISTER_COUNT) { // Só há operações de ponto flutuante com registers.int > 0.
+            printRSGroup("ADD.D/SUB.D", fpAddRS.data(), fpAddRS.size()); printRSGroup("MUL.D/DIV.D", fpMulRS.data(), fpMulRS.size());
+        }
+
+        for (int t = 0; t < THREAD_COUNT; ++t) { // O ROB e a renomeação são de cada thread.
+            selectThread(t);
+            if (THREAD_COUNT > 1) *out << "\n--- Thread " << t << " ---" << endl;
+            printReorderBuffer();
+        }
+        selectThread(0);
+    }
+
+    // Tabela de instruções da thread ativa (ver printStatus).
+    void printInstructionTable() {
+        // Tabela de Status das Instruções: mostra o progresso de cada instrução.
+        *out << "\nInstrucoes:" << endl;
+        printFormatted("---------------------------------------------------------------------------------\n");
+        printFormatted("| %-1s | %-18s | %-7s | %-9s | %-11s | %-11s |\n", "#", "Instrucao", "Emissao", "Exec Comp", "WriteResult", "Commit");
+        printFormatted("---------------------------------------------------------------------------------\n");
+        // Sem histórico, as instruções já cometidas não estão mais na memória.
+        int firstRow = keepHistory ? historyStart : committedCount;
+        if (firstRow > 0) printFormatted("| (%d instrucoes ja cometidas omitidas)\n", firstRow);
+        // Com desvios, as linhas são as instruções dinâmicas (na ordem de busca): só as já buscadas.
+        int rowCount = streaming || activeProgram->hasControlFlow() ? fetchedCount : static_cast<int>(activeProgram->size());
+        const Instruction notFetched;
+        for (int i = firstRow; i < rowCount; ++i) {
+            const InFlightInstruction *row = i < committedCount ? &history[i - historyStart] : i < fetchedCount ? &inFlight(i) : nullptr;
+            const Instruction &inst = row ? row->timing : notFetched;
+            string instStr = instructionText(row ? row->decoded : (*activeProgram)[i]); // Formata a instrução como string.
+            // Imprime os ciclos de cada estágio. "-" se ainda não ocorreu.
+            printFormatted("| %-1d | %-18s | %-7s | %-9s | %-11s | %-11s |\n", i, instStr.c_str(),
+                (inst.issue != -1 ? to_string(inst.issue).c_str() : "-"),
+                (inst.execComp != -1 ? to_string(inst.execComp).c_str() : "-"),
+                (inst.writeResult != -1 ? to_string(inst.writeResult).c_str() : "-"),
+                (inst.commitCycle != -1 ? to_string(inst.commitCycle).c_str() : "-"));
+        }
+        printFormatted("---------------------------------------------------------------------------------\n");
+    }
+
+    // Reorder Buffer e renomeação (status dos registradores ou mapa dos físicos) da thread ativa.
+    void printReorderBuffer() {
+        // Tabela do Reorder Buffer (ROB).
+        *out << "\nReorder Buffer (ROB): Head=" << robHead << ", Tail=" << robTail << ", Available=" << robEntriesAvailable << endl;
+        const char *robTableFormat = "| %-4d | %-4s | %-7s | %-5s | %-11s | %-7s | %-6s | %-5s | %-7s |\n";
+        *out << "------------------------------------------------------------------------------------------" << endl;
+        *out << "| ROB# | Busy | InstIdx | Type  | State       | DestReg | ValRdy | Value | Address |" << endl;
+        *out << "------------------------------------------------------------------------------------------" << endl;
+        for (int i = 0; i < ROB_SIZE; ++i) { // Itera por todas as entradas do ROB.
+            const auto &entry = rob[i];
+            // Converte enums para strings para facilitar a leitura.
+            string typeStr = entry.busy ? instructionTypeName(entry.type) : "---";
+            string stateStr = entry.busy ? (entry.state == ROB_ISSUE ? "Issue" : entry.state == ROB_EXECUTE ? "Execute" : entry.state == ROB_WRITERESULT ? "WriteRes" : "Empty") : "---";
+            bool isDouble = entry.busy && (entry.type == STORE ? storesDouble(inFlight(entry.instructionIndex).decoded) : holdsDouble(entry.destinationRegister));
+            string value_s = (entry.busy && entry.valueReady) ? wordText(entryResult(entry), isDouble) : "-";
+            // Endereço só é relevante para LOAD/STORE e se já foi calculado.
+            string address_s = (entry.busy && (entry.type == LOAD || entry.type == STORE) && entry.address != 0 ) ? to_string(entry.address) : "-";
+            // Caso especial: STORE pode estar em WriteResult (endereço pronto) mas com dado pendente.
+            if (entry.busy && entry.type == STORE && !entry.valueReady && entry.state == ROB_WRITERESULT) value_s = "(pend)";
+
+            printFormatted(robTableFormat, i, (entry.busy ? "Sim" : "Nao"),
+                (entry.busy && entry.instructionIndex != -1 ? to_string(entry.instructionIndex).c_str() : "-"),
+                typeStr.c_str(), stateStr.c_str(),
+                (entry.busy && entry.destinationRegister >= 0 ? registerName(entry.destinationRegister).c_str() : "-"),
+                (entry.busy ? (entry.valueReady ? "Sim" : "Nao") : "-"),
+                value_s.c_str(), address_s.c_str());
+        }
+        *out << "------------------------------------------------------------------------------------------" << endl;
+
+        // rename = prf: tabela de mapeamento (só os registradores fora do físico inicial ou pendentes).
+        if (RENAME_MODE == RENAME_PRF) {
+            *out << "\nMapa de Renomeacao (fisicos livres: " << freePhysical.size() << " de " << PHYSICAL_REGISTER_COUNT << "):" << endl;
+            printFormatted("-----------------------------------\n");
+            printFormatted("| Reg | Fisico | Pronto | ROB#    |\n");
+            printFormatted("-----------------------------------\n");
+            for (int reg = 0; reg < REGISTER_COUNT; ++reg) {
+                int phys = renameMap[reg];
+                if (phys == reg && physicalReady[phys]) continue;
+                printFormatted("| %-3s | P%-5d | %-6s | %-7s |\n", registerName(reg).c_str(), phys, physicalReady[phys] ? "Sim" : "Nao",
+                    physicalReady[phys] ? "-" : to_string(physicalProducer[phys]).c_str());
+            }
+            printFormatted("-----------------------------------\n");
+            return;
+        }
+
+        // Tabela de Status dos Registradores: mostra quais registradores estão aguardando resultados.
+        *out << "\nRegister Status:" << endl;
+        printFormatted("---------------------\n");
+        printFormatted("| Reg | Busy | ROB# |\n");
+        printFormatted("---------------------\n");
+        bool anyRegBusy = false; // Flag para verificar se algum registrador está ocupado.
+        for (int reg = 0; reg < REGISTER_COUNT; ++reg) { // Itera sobre a tabela de status de registradores.
+            if (regStatus[reg].busy) { // Imprime apenas os que estão ocupados.
+                anyRegBusy = true;
+                printFormatted("| %-3s | %-4s | %-4s |\n",
+                    registerName(reg).c_str(), "Sim", to_string(regStatus[reg].robIndex).c_str());
+            }
+        }
+        if (!anyRegBusy) { // Se nenhum estiver ocupado, imprime uma linha indicando isso.
+             printFormatted("| --- | Nao  | -    |\n");
+        }
+        printFormatted("---------------------\n");
+    }
+}; // Fim da classe TomasuloSimulatorCore
+
+// Simulador configurado em tempo de execução (todos os parâmetros da MachineConfig).
+typedef TomasuloSimulatorCore<DynamicShape> TomasuloSimulator;
+
+// --- Varredura em lote ---
+// Várias máquinas que diferem só nas RSs e nas latências, simuladas juntas, ciclo a ciclo, sobre
+// o mesmo programa: uma pista por máquina. Os campos das RSs (busy, Qj, Qk, pronta) e das
+// entradas do ROB são guardados campo a campo e, em cada campo, pista a pista (estrutura de
+// vetores). Assim, a comparação das tags transmitidas no CDB percorre as pistas em sequência,
+// sem desvios, e o compilador pode vetorizá-la.
+// Vale para programas sem desvios, com uma thread, rename = rob, sem caches e memory_order =
+// conservative (com none, um LOAD pode ler a memória antes de um STORE anterior, e o valor
+// passa a depender do tempo). Nesses casos, os valores, os endereços dos LOADs/STOREs e os erros não
+// dependem da máquina nem do tempo, e vêm de uma única execução no modelo de referência. As
+// pistas simulam só o tempo, com as regras de stepSimulation(), e chegam aos mesmos ciclos e
+// paradas do Issue que uma instância do simulador por máquina.
+class LockstepSweep {
+public:
+    // Resultado de uma máquina (pista).
+    struct LaneResult {
+        int cycles = 0;
+        long long robFullStalls = 0, rsFullStalls = 0; // Ciclos em que o Issue parou por ROB ou RS cheios.
+    };
+
+    // A máquina pode ser simulada em lote? (O programa também não pode ter desvios, ver Program::hasControlFlow.)
+    // Só com memory_order = conservative os valores lidos pelos LOADs não dependem do tempo.
+    static bool supports(const MachineConfig &config) {
+        return config.threadCount == 1 && config.renameMode == RENAME_ROB && config.l1Size == 0 &&
+               config.memoryOrder == MEMORY_ORDER_CONSERVATIVE;
+    }
+
+    // Máquinas com a mesma chave diferem só nas RSs e nas latências e podem ir no mesmo lote.
+    static string batchKey(const MachineConfig &config) {
+        MachineConfig shared = config;
+        MachineConfig defaults;
+        for (int g = 0; g < RS_GROUP_COUNT; ++g) shared.*rsCountField(static_cast<RSGroup>(g)) = defaults.*rsCountField(static_cast<RSGroup>(g));
+        shared.addLatency = defaults.addLatency; shared.mulLatency = defaults.mulLatency; shared.divLatency = defaults.divLatency;
+        shared.loadLatency = defaults.loadLatency; shared.storeLatency = defaults.storeLatency;
+        shared.fpAddLatency = defaults.fpAddLatency; shared.fpMulLatency = defaults.fpMulLatency; shared.fpDivLatency = defaults.fpDivLatency;
+        ostringstream key;
+        writeMachineConfig(key, shared);
+        return key.str();
+    }
+
+    // Executa o programa no modelo de referência ('reference', o estado inicial de uma das
+    // máquinas) e guarda, por instrução, as fontes, o destino e o endereço acessado.
+    LockstepSweep(const Program &program, ReferenceModel reference, const MachineConfig &config) :
+        ROB_SIZE(config.robSize), ISSUE_WIDTH(config.issueWidth), CDB_COUNT(config.cdbCount), COMMIT_WIDTH(config.commitWidth),
+        REGISTER_COUNT(config.registerCount + config.intRegisterCount)
+    {
+        steps.resize(program.size());
+        int lastStore = -1;
+        for (size_t i = 0; i < program.size(); ++i) {
+            const DecodedInstruction &inst = program[i];
+            Step &step = steps[i];
+            step.type = inst.type();
+            step.group = groupFor(step.type);
+            step.unit = functionalUnitFor(step.type);
+            step.robEntry = static_cast<int>(i % config.robSize);
+            // As fontes que issueInstruction() lê: o LOAD só usa a base; ADDI/SUBI e CVT, só src1.
+            const int src1 = registerIndex(inst.src1, config.registerCount), src2 = registerIndex(inst.src2, config.registerCount);
+            step.src1 = step.type == LOAD ? -1 : src1;
+            step.src2 = usesImmediate(step.type) || isConversion(step.type) ? -1 : src2;
+            step.dest = registerIndex(inst.dest, config.registerCount);
+            // Os erros que o pipeline reporta: divisão por zero e LOAD/STORE fora da memória.
+            Word base = src2 >= 0 ? reference.reg(src2) : 0;
+            if (step.type == DIV && base == 0) errors++;
+            if (step.type == LOAD || step.type == STORE) {
+                step.address = effectiveAddress(inst.imm, base);
+                if (step.address < 0 || step.address >= config.memorySize) errors++;
+                step.previousStore = lastStore;
+                if (step.type == STORE) lastStore = static_cast<int>(i);
+            }
+            reference.step(inst);
+        }
+    }
+
+    int getInstructionCount() const { return static_cast<int>(steps.size()); }
+    // Mensagens de erro que cada simulação do programa escreve (as mesmas em todas as máquinas).
+    int getErrorCount() const { return errors; }
+
+    // Máquinas por lote. Com a quantidade de pistas fixa, os laços pelas pistas têm um número
+    // fixo de iterações, que o compilador vetoriza já com -O2.
+    static const int LANES = 16;
+
+    // Simula as máquinas 'lanes' (até LANES, todas com a chave da máquina do construtor) e
+    // retorna o resultado de cada uma. Pode ser chamada de várias threads ao mesmo tempo.
+    vector<LaneResult> run(const vector<MachineConfig> &lanes) const {
+        Batch batch(*this, lanes);
+        return batch.run();
+    }
+
+private:
+    // Instrução do programa, do ponto de vista do tempo.
+    struct Step {
+        InstructionType type = INVALID;
+        RSGroup group = RS_NONE;
+        FUType unit = FU_ADD;
+        int src1 = -1, src2 = -1, dest = -1; // Índices no banco (-1: não lido ou sem destino).
+        int robEntry = 0;                    // Sem desvios, a instrução i ocupa sempre a entrada i % ROB_SIZE.
+        int address = 0;                     // LOAD/STORE: endereço efetivo.
+        int previousStore = -1;              // LOAD/STORE: o STORE anterior no programa (-1: nenhum).
+    };
+
+    vector<Step> steps;
+    int errors = 0;
+    const int ROB_SIZE, ISSUE_WIDTH, CDB_COUNT, COMMIT_WIDTH, REGISTER_COUNT;
+
+    // Grupo de RS de cada tipo de instrução (o de findFreeRS()).
+    static RSGroup groupFor(InstructionType type) {
+        if (type == ADD || type == SUB || type == BEQ || type == BNE || usesImmediate(type)) return RS_ADD;
+        if (type == MUL || type == DIV) return RS_MUL;
+        if (type == ADD_D || type == SUB_D || isConversion(type)) return RS_FPADD;
+        if (type == MUL_D || type == DIV_D) return RS_FPMUL;
+        if (type == LOAD) return RS_LOAD;
+        if (type == STORE) return RS_STORE;
+        return RS_NONE;
+    }
+
+    static int MachineConfig::*rsCountField(RSGroup group) {
+        switch (group) {
+            case RS_ADD: return &MachineConfig::addRS;
+            case RS_MUL: return &MachineConfig::mulRS;
+            case RS_LOAD: return &MachineConfig::loadRS;
+            case RS_STORE: return &MachineConfig::storeRS;
+            case RS_FPADD: return &MachineConfig::fpAddRS;
+            default: return &MachineConfig::fpMulRS;
+        }
+    }
+
+    // Latência de cada tipo de instrução na máquina (a de latencyOf()).
+    static int latencyFor(const MachineConfig &config, InstructionType type) {
+        switch (type) {
+            case ADD: case SUB: case ADDI: case SUBI: return config.addLatency;
+            case MUL: return config.mulLatency;
+            case DIV: return config.divLatency;
+            case LOAD: return config.loadLatency;
+            case STORE: return config.storeLatency;
+            case ADD_D: case SUB_D: case CVT_D_W: case CVT_W_D: return config.fpAddLatency;
+            case MUL_D: return config.fpMulLatency;
+            case DIV_D: return config.fpDivLatency;
+            default: return 1;
+        }
+    }
+
+    // Instrução que terminou a execução (ou espera o CDB), identificada pela pista e pela RS.
+    struct Event { int lane, group, slot; };
+
+    // Tag transmitida por uma pista que não escreve no CDB nesta rodada: não corresponde a
+    // nenhuma entrada do ROB nem a TAG_READY.
+    enum { NO_TAG = -2 };
+
+    // Estado de um lote. O índice de um campo é 'linha * LANES + pista', onde a linha é a
+    // entrada do ROB, a RS (os grupos em sequência), a unidade funcional ou o registrador.
+    // Um lote com menos máquinas que LANES completa as pistas com pistas vazias, já terminadas
+    // e sem RSs, para que os laços pelas pistas tenham sempre LANES iterações.
+    class Batch {
+    public:
+        Batch(const LockstepSweep &owner, const vector<MachineConfig> &lanes) :
+            sweep(owner), INSTRUCTIONS(owner.getInstructionCount()), LANES_USED(static_cast<int>(lanes.size())), results(lanes.size())
+        {
+            for (int l = 0; l < LANES; ++l) {
+                issued[l] = committed[l] = 0;
+                finished[l] = l >= LANES_USED || INSTRUCTIONS == 0; // Sem instruções, todas terminam no ciclo 0.
+                broadcastTag[l] = NO_TAG;
+                cdbHead[l] = cdbSize[l] = 0;
+            }
+            // RSs: em cada grupo, a maior quantidade entre as pistas. As que sobram em uma pista ficam sempre livres.
+            int stations = 0;
+            rsCount.assign(RS_GROUP_COUNT * LANES, 0);
+            for (int g = 0; g < RS_GROUP_COUNT; ++g) {
+                groupBase[g] = stations;
+                groupSlots[g] = 0;
+                for (int l = 0; l < LANES_USED; ++l) {
+                    rsCount[g * LANES + l] = lanes[l].*rsCountField(static_cast<RSGroup>(g));
+                    groupSlots[g] = max(groupSlots[g], rsCount[g * LANES + l]);
+                }
+                stations += groupSlots[g];
+            }
+            rsBusy.assign(stations * LANES, 0);
+            rsReady.assign(stations * LANES, 0);
+            rsQj.assign(stations * LANES, TAG_READY);
+            rsQk.assign(stations * LANES, TAG_READY);
+            rsInstruction.assign(stations * LANES, -1);
+
+            // Unidades funcionais: o padrão do simulador (uma pipelined por RS) e as da descrição da máquina.
+            unitCount.assign(FU_TYPE_COUNT * LANES, 0);
+            unitPipelined.assign(FU_TYPE_COUNT * LANES, 1);
+            unitInterval.assign(FU_TYPE_COUNT * LANES, 1);
+            latency.assign((INVALID + 1) * LANES, 1);
+            int worstLatency = 1;
+            for (int l = 0; l < LANES_USED; ++l) {
+                const MachineConfig &config = lanes[l];
+                const int defaults[FU_TYPE_COUNT] = {config.addRS, config.mulRS, config.mulRS, config.loadRS, config.storeRS,
+                                                     config.fpAddRS, config.fpMulRS, config.fpMulRS};
+                for (int f = 0; f < FU_TYPE_COUNT; ++f) unitCount[f * LANES + l] = defaults[f];
+                for (size_t i = 0; i < config.functionalUnits.size(); ++i) {
+                    const MachineConfig::FunctionalUnitConfig &fu = config.functionalUnits[i];
+                    unitCount[fu.type * LANES + l] = max(fu.count, 0);
+                    unitPipelined[fu.type * LANES + l] = fu.pipelined;
+                    unitInterval[fu.type * LANES + l] = max(fu.issueInterval, 1);
+                }
+                for (int t = 0; t <= INVALID; ++t) {
+                    latency[t * LANES + l] = max(latencyFor(config, static_cast<InstructionType>(t)), 1);
+                    worstLatency = max(worstLatency, latency[t * LANES + l]);
+                }
+            }
+            int units = 0;
+            for (int f = 0; f < FU_TYPE_COUNT; ++f) {
+                unitBase[f] = units;
+                int most = 0;
+                for (int l = 0; l < LANES_USED; ++l) most = max(most, unitCount[f * LANES + l]);
+                units += most;
+            }
+            unitNextFree.assign(units * LANES, 0);
+
+            robWritten.assign(sweep.ROB_SIZE * LANES, 0);
+            robValueReady.assign(sweep.ROB_SIZE * LANES, 0);
+            robAddressReady.assign(sweep.ROB_SIZE * LANES, 0);
+            producer.assign(sweep.REGISTER_COUNT * LANES, -1);
+            executionWheel.resize(worstLatency + 1); // Um balde a mais que a maior latência, como no simulador.
+            cdbQueue.resize(sweep.ROB_SIZE * LANES); // Cada instrução em voo tem no máximo um evento.
+        }
+
+        vector<LaneResult> run() {
+            int active = 0;
+            for (int l = 0; l < LANES; ++l) active += !finished[l];
+            for (int cycle = 0; active > 0; ++cycle) {
+                active -= commit(cycle);
+                writeBack();
+                issue();
+                startExecution(cycle);
+                advanceExecution(cycle);
+            }
+            return results;
+        }
+
+    private:
+        const LockstepSweep &sweep;
+        const int INSTRUCTIONS, LANES_USED;
+        vector<LaneResult> results;
+        int issued[LANES], committed[LANES]; // Por pista: instruções emitidas e cometidas.
+        bool finished[LANES];
+        int groupBase[RS_GROUP_COUNT], groupSlots[RS_GROUP_COUNT]; // Primeira linha e linhas de cada grupo de RS.
+        vector<int> rsCount;                                       // Por grupo e pista.
+        vector<int> rsBusy, rsReady;                               // rsReady: na lista readyRS do simulador.
+        vector<int> rsQj, rsQk, rsInstruction;
+        int unitBase[FU_TYPE_COUNT];
+        vector<int> unitCount, unitInterval, unitNextFree;
+        vector<char> unitPipelined;
+        vector<int> latency;                                       // Por tipo de instrução e pista.
+        vector<char> robWritten, robValueReady, robAddressReady;   // Estado ROB_WRITERESULT, valueReady e addressReady.
+        vector<int> producer;                                      // Por registrador: entrada do ROB produtora (-1: nenhuma).
+        vector<vector<Event> > executionWheel;                     // Compartilhada: cada evento diz a sua pista.
+        vector<Event> cdbQueue;                                    // Fila do CDB de cada pista: circular, ROB_SIZE eventos.
+        int cdbHead[LANES], cdbSize[LANES];
+        int broadcastTag[LANES];                                   // Rodada atual do CDB: tag de cada pista.
+        Event broadcastEvent[LANES];
+
+        // Commit em ordem, até COMMIT_WIDTH instruções por pista. Retorna quantas pistas terminaram.
+        int commit(int cycle) {
+            int done = 0;
+            for (int l = 0; l < LANES; ++l) {
+                if (finished[l]) continue;
+                for (int n = 0; n < sweep.COMMIT_WIDTH && committed[l] < issued[l]; ++n) {
+                    const int entry = sweep.steps[committed[l]].robEntry;
+                    if (!robWritten[entry * LANES + l]) break; // No STORE, o dado já chegou no WriteResult.
+                    const int dest = sweep.steps[committed[l]].dest;
+                    if (dest >= 0 && producer[dest * LANES + l] == entry) producer[dest * LANES + l] = -1;
+                    committed[l]++;
+                }
+                if (committed[l] == INSTRUCTIONS) { // O ciclo do último commit é o último da simulação.
+                    finished[l] = true;
+                    results[l].cycles = cycle + 1;
+                    done++;
+                }
+            }
+            return done;
+        }
+
+        // WriteResult: em cada rodada, até um resultado por pista ocupa o CDB e a tag é
+        // comparada com as de todas as RSs de todas as pistas de uma vez.
+        void writeBack() {
+            for (int round = 0; round < sweep.CDB_COUNT; ++round) {
+                bool any = false;
+                for (int l = 0; l < LANES; ++l) {
+                    broadcastTag[l] = NO_TAG;
+                    if (finished[l] || cdbSize[l] == 0) continue;
+                    const Event &event = cdbQueue[l * sweep.ROB_SIZE + cdbHead[l]];
+                    const int entry = sweep.steps[rsInstruction[(groupBase[event.group] + event.slot) * LANES + l]].robEntry;
+                    robWritten[entry * LANES + l] = 1;
+                    robValueReady[entry * LANES + l] = 1;
+                    broadcastTag[l] = entry;
+                    broadcastEvent[l] = event;
+                    cdbHead[l] = cdbHead[l] + 1 == sweep.ROB_SIZE ? 0 : cdbHead[l] + 1;
+                    cdbSize[l]--;
+                    any = true;
+                }
+                if (!any) return;
+                for (int g = 0; g < RS_GROUP_COUNT; ++g) {
+                    for (int s = 0; s < groupSlots[g]; ++s) updateStations(g, (groupBase[g] + s) * LANES);
+                }
+                for (int l = 0; l < LANES; ++l) { // Libera a RS de quem escreveu.
+                    if (broadcastTag[l] == NO_TAG) continue;
+                    const int row = (groupBase[broadcastEvent[l].group] + broadcastEvent[l].slot) * LANES + l;
+                    rsBusy[row] = 0;
+                    rsInstruction[row] = -1;
+                }
+            }
+        }
+
+        // updateDependentRS() de uma RS em todas as pistas ('row': a linha da RS). As RSs livres
+        // têm Qj = Qk = TAG_READY, que nunca é transmitida, então não precisam ser testadas.
+        void updateStations(int group, int row) {
+            int *qj = &rsQj[row], *qk = &rsQk[row], *ready = &rsReady[row];
+            int hitJ[LANES], hitK[LANES];
+            int any = 0;
+            for (int l = 0; l < LANES; ++l) {
+                hitJ[l] = qj[l] == broadcastTag[l];
+                hitK[l] = qk[l] == broadcastTag[l];
+                any |= hitJ[l] | hitK[l];
+            }
+            if (!any) return;
+            if (group == RS_LOAD || group == RS_STORE) {
+                for (int l = 0; l < LANES; ++l) {
+                    if (!hitJ[l] && !hitK[l]) continue;
+                    const int entry = sweep.steps[rsInstruction[row + l]].robEntry * LANES + l;
+                    if (hitJ[l]) robValueReady[entry] = 1; // O dado do STORE.
+                    if (hitK[l]) robAddressReady[entry] = 1; // A base do LOAD/STORE.
+                }
+            }
+            for (int l = 0; l < LANES; ++l) {
+                qj[l] = hitJ[l] ? TAG_READY : qj[l];
+                qk[l] = hitK[l] ? TAG_READY : qk[l];
+                ready[l] |= (hitJ[l] | hitK[l]) & (qj[l] == TAG_READY) & (qk[l] == TAG_READY);
+            }
+        }
+
+        // Issue em ordem, até ISSUE_WIDTH instruções por pista, e o motivo da parada.
+        void issue() {
+            for (int l = 0; l < LANES; ++l) {
+                if (finished[l]) continue;
+                int issuedNow = 0;
+                IssueStallCause cause = ISSUE_OK;
+                for (; issuedNow < sweep.ISSUE_WIDTH; ++issuedNow) {
+                    const int i = issued[l];
+                    if (i >= INSTRUCTIONS) { cause = STALL_NO_INSTRUCTION; break; }
+                    if (i - committed[l] == sweep.ROB_SIZE) { cause = STALL_ROB_FULL; break; }
+                    const Step &step = sweep.steps[i];
+                    const int slot = findFreeStation(step.group, l);
+                    if (slot < 0) { cause = STALL_RS_ADD_FULL; break; } // Qualquer grupo: o CSV soma as RSs cheias.
+                    const int entry = step.robEntry * LANES + l;
+                    robWritten[entry] = robValueReady[entry] = robAddressReady[entry] = 0;
+                    const int row = (groupBase[step.group] + slot) * LANES + l;
+                    rsBusy[row] = 1;
+                    rsInstruction[row] = i;
+                    rsQj[row] = operandTag(step.src1, l);
+                    rsQk[row] = operandTag(step.src2, l);
+                    rsReady[row] = rsQj[row] == TAG_READY && rsQk[row] == TAG_READY;
+                    if (step.type == STORE && rsQj[row] == TAG_READY) robValueReady[entry] = 1;
+                    if ((step.type == LOAD || step.type == STORE) && rsQk[row] == TAG_READY) robAddressReady[entry] = 1;
+                    if (step.dest >= 0) producer[step.dest * LANES + l] = step.robEntry;
+                    issued[l]++;
+                }
+                if (cause == STALL_ROB_FULL) results[l].robFullStalls++;
+                else if (cause == STALL_RS_ADD_FULL) results[l].rsFullStalls++;
+            }
+        }
+
+        // A RS livre de menor índice do grupo na pista, ou -1.
+        int findFreeStation(RSGroup group, int lane) const {
+            for (int s = 0; s < rsCount[group * LANES + lane]; ++s) {
+                if (!rsBusy[(groupBase[group] + s) * LANES + lane]) return s;
+            }
+            return -1;
+        }
+
+        // Tag do operando 'reg' na emissão: a entrada do ROB produtora, se o valor ainda não foi escrito.
+        int operandTag(int reg, int lane) const {
+            if (reg < 0) return TAG_READY;
+            const int entry = producer[reg * LANES + lane];
+            return entry >= 0 && !robWritten[entry * LANES + lane] ? entry : TAG_READY;
+        }
+
+        // Início da execução: grupo a grupo e, em cada grupo, em ordem de RS, como startExecution().
+        void startExecution(int cycle) {
+            for (int g = 0; g < RS_GROUP_COUNT; ++g) {
+                for (int s = 0; s < groupSlots[g]; ++s) {
+                    const int row = (groupBase[g] + s) * LANES;
+                    int any = 0;
+                    for (int l = 0; l < LANES; ++l) any |= rsReady[row + l];
+                    if (!any) continue;
+                    for (int l = 0; l < LANES; ++l) {
+                        if (!rsReady[row + l]) continue;
+                        const int i = rsInstruction[row + l];
+                        const Step &step = sweep.steps[i];
+                        if (step.type == LOAD && !olderStoresAllow(i, l)) continue;
+                        const int unit = findFreeUnit(step.unit, l, cycle);
+                        if (unit < 0) continue;
+                        const int opLatency = latency[step.type * LANES + l];
+                        unitNextFree[unit] = cycle + (unitPipelined[step.unit * LANES + l] ? unitInterval[step.unit * LANES + l] : opLatency);
+                        Event event = {l, g, s};
+                        executionWheel[(cycle + opLatency - 1) % executionWheel.size()].push_back(event);
+                        if (step.type == STORE) robValueReady[step.robEntry * LANES + l] = 1;
+                        rsReady[row + l] = 0;
+                    }
+                }
+            }
+        }
+
+        // Índice em unitNextFree da primeira unidade do tipo livre neste ciclo na pista, ou -1.
+        int findFreeUnit(FUType type, int lane, int cycle) const {
+            for (int u = 0; u < unitCount[type * LANES + lane]; ++u) {
+                const int index = (unitBase[type] + u) * LANES + lane;
+                if (unitNextFree[index] <= cycle) return index;
+            }
+            return -1;
+        }
+
+        // checkOlderStores() sem os índices do ROB: os STOREs mais antigos que o LOAD 'i', do mais
+        // novo para o mais antigo, enquanto ainda não foram cometidos.
+        bool olderStoresAllow(int i, int lane) const {
+            const int address = sweep.steps[i].address;
+            for (int store = sweep.steps[i].previousStore; store >= committed[lane]; store = sweep.steps[store].previousStore) {
+                const int entry = sweep.steps[store].robEntry * LANES + lane;
+                if (!robAddressReady[entry]) return false;
+                if (sweep.steps[store].address != address) continue;
+                return robValueReady[entry] != 0;
+            }
+            return true;
+        }
+
+        // As instruções que terminam neste ciclo entram na fila do CDB da sua pista.
+        void advanceExecution(int cycle) {
+            vector<Event> &finishing = executionWheel[cycle % executionWheel.size()];
+            for (size_t e = 0; e < finishing.size(); ++e) {
+                const int lane = finishing[e].lane;
+                int tail = cdbHead[lane] + cdbSize[lane]++;
+                if (tail >= sweep.ROB_SIZE) tail -= sweep.ROB_SIZE;
+                cdbQueue[lane * sweep.ROB_SIZE + tail] = finishing[e];
+            }
+            finishing.clear();
+        }
+    };
+};
+
+// Cria o simulador para a descrição da máquina e chama action(simulador). Com CORE_AUTO
+// usa o núcleo especializado cuja forma corresponde à máquina, se houver; senão, o dinâmico.
+// Retorna false (sem chamar action) se CORE_FIXED e nenhuma forma especializada corresponde.
+template <class Action>
+bool withSimulator(const MachineConfig &config, CoreMode mode, Action &action) {
+    if (mode != CORE_DYNAMIC) {
+        if (DefaultShape::matches(config)) { TomasuloSimulatorCore<DefaultShape> simulator(config); action(simulator); return true; }
+        if (SmallShape::matches(config)) { TomasuloSimulatorCore<SmallShape> simulator(config); action(simulator); return true; }
+        if (WideShape::matches(config)) { TomasuloSimulatorCore<WideShape> simulator(config); action(simulator); return true; }
+        if (mode == CORE_FIXED) return false;
+    }
+    TomasuloSimulator simulator(config);
+    action(simulator);
+    return true;
+}
+
+#endif // TOMASULO_H
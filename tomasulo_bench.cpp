@@ -0,0 +1,357 @@
+// Benchmark do simulador: mede a velocidade do próprio simulador (ciclos simulados e
+// instruções por segundo de tempo real) em cargas sintéticas, e compara com uma linha de base
+// gravada para pegar regressões de desempenho no caminho quente (stepSimulation()).
+// Usa só tomasulo.h, como qualquer outro programa que embute o simulador.
+
+#include "tomasulo.h"
+
+#include <chrono>  // steady_clock (tempo real de cada execução)
+#include <iomanip> // setprecision
+#include <map>     // linha de base por carga
+
+// Uma carga sintética: gera 'count' instruções no programa.
+struct BenchWorkload {
+    const char *name;
+    const char *description;
+    void (*generate)(Program &program, int count);
+};
+
+// Monta uma instrução já decodificada (NO_REGISTER nos campos não usados, como decodeLine).
+inline DecodedInstruction benchInstruction(InstructionType type, int dest, int src1, int src2, int imm = 0) {
+    DecodedInstruction inst = {static_cast<uint8_t>(type), 0,
+                               static_cast<uint16_t>(dest < 0 ? NO_REGISTER : dest),
+                               static_cast<uint16_t>(src1 < 0 ? NO_REGISTER : src1),
+                               static_cast<uint16_t>(src2 < 0 ? NO_REGISTER : src2), imm};
+    return inst;
+}
+
+// Os registradores começam com 10. F25..F31 nunca são escritos pelas cargas: servem de
+// operandos sempre prontos (e de divisor diferente de zero); F0 é a base dos LOADs/STOREs.
+
+// Fluxo de ADD/SUB independentes: o Issue e o Commit limitam, nunca os operandos.
+inline void generateIndependentALU(Program &program, int count) {
+    for (int i = 0; i < count; ++i) {
+        program.append(benchInstruction(i % 3 == 2 ? SUB : ADD, 1 + i % 24, 25 + i % 7, 25 + (i + 3) % 7));
+    }
+}
+
+// Cadeia de dependências: cada instrução lê o resultado da anterior (um MUL a cada oito).
+inline void generateDependencyChain(Program &program, int count) {
+    for (int i = 0; i < count; ++i) {
+        program.append(benchInstruction(i % 8 == 7 ? MUL : ADD, 1, 1, 25 + i % 7));
+    }
+}
+
+// Metade DIVs (40 ciclos no padrão) em quatro cadeias, intercaladas com ADDs independentes.
+inline void generateDivHeavy(Program &program, int count) {
+    for (int i = 0; i < count; ++i) {
+        if (i % 2 == 0) program.append(benchInstruction(DIV, 1 + (i / 2) % 4, 1 + (i / 2) % 4, 30));
+        else program.append(benchInstruction(ADD, 5 + i % 20, 25, 26));
+    }
+}
+
+// LOADs e STOREs (dois terços) sobre 256 palavras, com ADDs que consomem os valores lidos.
+inline void generateMemoryHeavy(Program &program, int count) {
+    for (int i = 0; i < count; ++i) {
+        int address = (i * 37) % 256;
+        switch (i % 3) {
+            case 0: program.append(benchInstruction(LOAD, 1 + i % 12, -1, 0, address)); break;
+            case 1: program.append(benchInstruction(STORE, -1, 1 + (i + 5) % 12, 0, address)); break;
+            default: program.append(benchInstruction(ADD, 13 + i % 12, 1 + (i + 2) % 12, 25)); break;
+        }
+    }
+}
+
+// Mistura: ALU, MUL/DIV, memória e um desvio a cada dezesseis instruções (BEQ tomado e BNE não
+// tomado para a instrução seguinte, então o caminho é o mesmo e o preditor trabalha).
+inline void generateMixed(Program &program, int count) {
+    for (int i = 0; i < count; ++i) {
+        int pc = static_cast<int>(program.size());
+        int dest = 1 + i % 24, src = 1 + (i * 7 + 3) % 24;
+        switch (i % 16) {
+            case 3: program.append(benchInstruction(MUL, dest, src, 27)); break;
+            case 7: program.append(benchInstruction(LOAD, dest, -1, 0, (i * 13) % 256)); break;
+            case 9: program.append(benchInstruction(STORE, -1, src, 0, (i * 29) % 256)); break;
+            case 11: program.append(benchInstruction(DIV, dest, src, 30)); break;
+            case 15: program.append(benchInstruction((i / 16) % 2 ? BNE : BEQ, -1, 25, 26, pc + 1)); break;
+            default: program.append(benchInstruction(i % 2 ? SUB : ADD, dest, src, 25 + i % 7)); break;
+        }
+    }
+}
+
+const BenchWorkload benchWorkloads[] = {
+    {"alu", "ADD/SUB independentes", generateIndependentALU},
+    {"chain", "cadeia de dependencias", generateDependencyChain},
+    {"div", "metade DIVs", generateDivHeavy},
+    {"memory", "LOADs e STOREs", generateMemoryHeavy},
+    {"mix", "mistura com desvios", generateMixed},
+};
+const int BENCH_WORKLOAD_COUNT = sizeof(benchWorkloads) / sizeof(benchWorkloads[0]);
+
+// Resultado de uma carga: a melhor (mais rápida) das repetições.
+struct BenchResult {
+    long long cycles = 0, instructions = 0;
+    long long issued = 0, written = 0, committed = 0; // Instruções processadas por estágio.
+    double seconds = 0.0;
+    StageProfile stages; // Só na execução com o perfil por estágio (ver main).
+
+    double perSecond(long long count) const { return seconds > 0 ? count / seconds : 0.0; }
+    // Instruções processadas pelo estágio por segundo gasto nele.
+    double stageRate(long long count, PipelineStage stage) const {
+        return stages.seconds[stage] > 0 ? count / stages.seconds[stage] : 0.0;
+    }
+};
+
+// Executa o programa até o fim no simulador recebido de withSimulator, medindo o tempo real
+// (e o de cada estágio, se 'profiled').
+struct BenchRun {
+    const Program &program;
+    bool eventDriven, profiled;
+    BenchResult result;
+    bool ok = false;
+    BenchRun(const Program &shared, bool skipIdle, bool perStage = false)
+        : program(shared), eventDriven(skipIdle), profiled(perStage) {}
+
+    template <class Simulator> void operator()(Simulator &simulator) {
+        ostringstream output, errors;
+        simulator.setOutput(output, errors);
+        simulator.setCommitLog(false);
+        simulator.setKeepHistory(false);
+        if (!simulator.useProgram(program)) return;
+        if (profiled) simulator.setStageProfile(&result.stages);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        if (eventDriven) simulator.runToCompletion();
+        else while (!simulator.isSimulationComplete()) simulator.stepSimulation();
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        const SimulatorStats &stats = simulator.getStats();
+        result.cycles = simulator.getCurrentCycle();
+        result.instructions = stats.committedInstructions;
+        result.issued = stats.issueWidth.total;
+        result.written = stats.cdbWidth.total;
+        result.committed = stats.commitWidth.total;
+        ok = true;
+    }
+};
+
+// Linha de base: as opções com que foi gravada e, por carga, ciclos simulados e ciclos
+// simulados por segundo. Formato: "instructions N", "mode stepped|event-driven" e uma linha
+// "carga ciclos ciclos_por_segundo" por carga; '#' inicia um comentário.
+struct BenchBaselineEntry { long long cycles; double cyclesPerSecond; };
+
+struct BenchBaseline {
+    int instructions = 0; // 0: arquivo sem o campo (formato antigo).
+    string mode;
+    map<string, BenchBaselineEntry> entries;
+};
+
+inline const char *benchModeName(bool eventDriven) { return eventDriven ? "event-driven" : "stepped"; }
+
+inline bool readBenchBaseline(const string &filename, BenchBaseline &baseline) {
+    ifstream file(filename.c_str());
+    if (!file) return false;
+    string line;
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream fields(line);
+        string name;
+        fields >> name;
+        if (name == "instructions") {
+            fields >> baseline.instructions;
+            continue;
+        }
+        if (name == "mode") {
+            fields >> baseline.mode;
+            continue;
+        }
+        BenchBaselineEntry entry;
+        if (fields >> entry.cycles >> entry.cyclesPerSecond) baseline.entries[name] = entry;
+    }
+    return true;
+}
+
+struct BenchOptions {
+    int instructions = 1000000; // Instruções por carga.
+    int repeat = 3;             // Repetições por carga (vale a mais rápida).
+    bool eventDriven = false;   // Pula os ciclos ociosos (runToCompletion) em vez de stepSimulation() a cada ciclo.
+    double tolerance = 10.0;    // Queda máxima aceita, em %, em relação à linha de base.
+    CoreMode core = CORE_AUTO;
+    MachineConfig machine;
+    vector<string> workloads;   // Vazio: todas.
+    string baselineFile, saveBaselineFile;
+};
+
+void printBenchUsage(const char *program) {
+    cerr << "Uso: " << program << " [--instructions N] [--repeat N] [--workload NOME]... [--event-driven]" << endl
+         << "       [--preset NOME] [--set CHAVE=VALOR]... [--core auto|dynamic]" << endl
+         << "       [--baseline ARQUIVO [--tolerance PCT]] [--save-baseline ARQUIVO]" << endl
+         << "  --instructions N    instrucoes de cada carga (padrao: 1000000)" << endl
+         << "  --repeat N          repeticoes de cada carga; vale a mais rapida (padrao: 3)" << endl
+         << "  --workload NOME     so a carga NOME (alu, chain, div, memory, mix); pode repetir" << endl
+         << "  --event-driven      pula os ciclos ociosos (por padrao, um stepSimulation() por ciclo)" << endl
+         << "  --baseline ARQ      compara os ciclos simulados por segundo com os de ARQ; termina com" << endl
+         << "                      erro se alguma carga ficar mais de PCT% mais lenta (padrao: 10)" << endl
+         << "  --save-baseline ARQ grava os resultados como nova linha de base" << endl;
+}
+
+bool parseBenchArguments(int argc, char *argv[], BenchOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--instructions" && hasValue) {
+            options.instructions = atoi(argv[++i]);
+            if (options.instructions <= 0) { cerr << "Valor invalido para --instructions: " << argv[i] << endl; return false; }
+        } else if (arg == "--repeat" && hasValue) {
+            options.repeat = atoi(argv[++i]);
+            if (options.repeat <= 0) { cerr << "Valor invalido para --repeat: " << argv[i] << endl; return false; }
+        } else if (arg == "--workload" && hasValue) {
+            string name = argv[++i];
+            int w = 0;
+            while (w < BENCH_WORKLOAD_COUNT && name != benchWorkloads[w].name) ++w;
+            if (w == BENCH_WORKLOAD_COUNT) { cerr << "Carga desconhecida: " << name << endl; return false; }
+            options.workloads.push_back(name);
+        } else if (arg == "--event-driven") {
+            options.eventDriven = true;
+        } else if (arg == "--preset" && hasValue) {
+            string name = argv[++i];
+            int p = 0;
+            while (p < MACHINE_PRESET_COUNT && name != machinePresets[p].name) ++p;
+            if (p == MACHINE_PRESET_COUNT) { cerr << "Preset desconhecido: " << name << endl; return false; }
+            machinePresets[p].applyTo(options.machine);
+        } else if (arg == "--set" && hasValue) {
+            string setting = argv[++i], error;
+            size_t eq = setting.find('=');
+            if (eq == string::npos) error = "esperado CHAVE=VALOR: " + setting;
+            if (!error.empty() || !applyMachineSetting(options.machine, setting.substr(0, eq), setting.substr(eq + 1), error)) {
+                cerr << "--set: " << error << endl;
+                return false;
+            }
+        } else if (arg == "--core" && hasValue) {
+            string mode = argv[++i];
+            if (mode == "auto") options.core = CORE_AUTO;
+            else if (mode == "dynamic") options.core = CORE_DYNAMIC;
+            else { cerr << "Nucleo invalido: " << mode << " (esperado auto ou dynamic)" << endl; return false; }
+        } else if (arg == "--baseline" && hasValue) {
+            options.baselineFile = argv[++i];
+        } else if (arg == "--tolerance" && hasValue) {
+            options.tolerance = atof(argv[++i]);
+            if (options.tolerance < 0) { cerr << "Valor invalido para --tolerance: " << argv[i] << endl; return false; }
+        } else if (arg == "--save-baseline" && hasValue) {
+            options.saveBaselineFile = argv[++i];
+        } else {
+            cerr << "Argumento nao reconhecido: " << arg << endl;
+            return false;
+        }
+    }
+    string error;
+    if (!validateMachineConfig(options.machine, error)) {
+        cerr << "Configuracao invalida: " << error << endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    if (!parseBenchArguments(argc, argv, options)) {
+        printBenchUsage(argv[0]);
+        return 1;
+    }
+    BenchBaseline baseline;
+    if (!options.baselineFile.empty()) {
+        if (!readBenchBaseline(options.baselineFile, baseline)) {
+            cerr << "Erro ao abrir a linha de base: " << options.baselineFile << endl;
+            return 1;
+        }
+        // Com outro tamanho de carga ou outro modo, os ciclos por segundo não são comparáveis.
+        if (baseline.instructions != options.instructions || baseline.mode != benchModeName(options.eventDriven)) {
+            cerr << "Erro: a linha de base " << options.baselineFile << " foi gravada com ";
+            if (baseline.instructions == 0 || baseline.mode.empty()) cerr << "opcoes desconhecidas (sem os campos instructions e mode)";
+            else cerr << baseline.instructions << " instrucoes por carga e modo " << baseline.mode;
+            cerr << "; esta execucao usa " << options.instructions << " instrucoes e modo " << benchModeName(options.eventDriven) << endl;
+            return 1;
+        }
+    }
+
+    cout << "Benchmark do simulador: " << options.instructions << " instrucoes por carga, melhor de " << options.repeat
+         << (options.eventDriven ? " (pulando ciclos ociosos)" : " (um stepSimulation() por ciclo)") << endl;
+    cout << "Taxas em milhoes por segundo de tempo real (Issue, CDB e Commit: instrucoes processadas pelo estagio" << endl
+         << "por segundo gasto nele, medido em uma execucao a mais com o perfil por estagio)" << endl;
+    char line[200];
+    snprintf(line, sizeof(line), "%-8s %12s %6s %9s %9s %8s %8s %8s %8s\n",
+             "carga", "ciclos", "IPC", "tempo(s)", "Mciclos/s", "MIPS", "Issue", "CDB", "Commit");
+    cout << line;
+
+    ofstream saved;
+    if (!options.saveBaselineFile.empty()) {
+        saved.open(options.saveBaselineFile.c_str());
+        if (!saved) {
+            cerr << "Erro ao gravar a linha de base: " << options.saveBaselineFile << endl;
+            return 1;
+        }
+        saved << "instructions " << options.instructions << "\n"
+              << "mode " << benchModeName(options.eventDriven) << "\n"
+              << "# carga ciclos ciclos_por_segundo\n";
+    }
+
+    int regressions = 0;
+    vector<string> notes; // Comparações com a linha de base, impressas depois da tabela.
+    for (int w = 0; w < BENCH_WORKLOAD_COUNT; ++w) {
+        const BenchWorkload &workload = benchWorkloads[w];
+        if (!options.workloads.empty() && find(options.workloads.begin(), options.workloads.end(), workload.name) == options.workloads.end()) continue;
+        Program program;
+        workload.generate(program, options.instructions);
+
+        BenchResult best;
+        for (int r = 0; r < options.repeat; ++r) {
+            BenchRun run(program, options.eventDriven);
+            withSimulator(options.machine, options.core, run);
+            if (!run.ok) {
+                cerr << "Falha ao carregar a carga " << workload.name << endl;
+                return 1;
+            }
+            if (r == 0 || run.result.seconds < best.seconds) best = run.result;
+        }
+        // O perfil lê o relógio a cada estágio e deixaria a execução mais lenta: fica fora das
+        // repetições cronometradas e só fornece o tempo de cada estágio.
+        BenchRun profiledRun(program, options.eventDriven, true);
+        withSimulator(options.machine, options.core, profiledRun);
+        if (!profiledRun.ok) {
+            cerr << "Falha ao carregar a carga " << workload.name << endl;
+            return 1;
+        }
+        best.stages = profiledRun.result.stages;
+
+        snprintf(line, sizeof(line), "%-8s %12lld %6.3f %9.3f %9.2f %8.2f %8.2f %8.2f %8.2f\n", workload.name, best.cycles,
+                 best.cycles > 0 ? static_cast<double>(best.instructions) / best.cycles : 0.0, best.seconds,
+                 best.perSecond(best.cycles) / 1e6, best.perSecond(best.instructions) / 1e6,
+                 best.stageRate(best.issued, STAGE_ISSUE) / 1e6, best.stageRate(best.written, STAGE_WRITEBACK) / 1e6,
+                 best.stageRate(best.committed, STAGE_COMMIT) / 1e6);
+        cout << line;
+        if (saved.is_open()) saved << workload.name << ' ' << best.cycles << ' ' << fixed << setprecision(0) << best.perSecond(best.cycles) << '\n';
+
+        map<string, BenchBaselineEntry>::const_iterator base = baseline.entries.find(workload.name);
+        if (base == baseline.entries.end()) {
+            if (!options.baselineFile.empty()) notes.push_back(string(workload.name) + ": sem linha de base");
+            continue;
+        }
+        double change = 100.0 * (best.perSecond(best.cycles) / base->second.cyclesPerSecond - 1.0);
+        bool slower = change < -options.tolerance;
+        if (slower) regressions++;
+        snprintf(line, sizeof(line), "%s: %+.1f%% em ciclos/s em relacao a linha de base%s", workload.name, change, slower ? " (REGRESSAO)" : "");
+        string note = line;
+        // Outro número de ciclos simulados: o simulador mudou de comportamento, não só de velocidade.
+        if (base->second.cycles != best.cycles) note += " [ciclos simulados: " + to_string(base->second.cycles) + " -> " + to_string(best.cycles) + "]";
+        notes.push_back(note);
+    }
+
+    if (!notes.empty()) {
+        cout << "\nComparacao com " << options.baselineFile << " (tolerancia de " << options.tolerance << "%):" << endl;
+        for (size_t i = 0; i < notes.size(); ++i) cout << "  " << notes[i] << endl;
+    }
+    if (saved.is_open()) cout << "Linha de base gravada em " << options.saveBaselineFile << endl;
+    if (regressions > 0) {
+        cout << regressions << " carga(s) mais lenta(s) que a linha de base" << endl;
+        return 1;
+    }
+    return 0;
+}